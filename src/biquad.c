@@ -6,7 +6,15 @@
 //
 
 #include "biquad.h"
+#include "mem.h"
+#include "denormal.h"
 #include <math.h>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 // biquad filtering is based on a small sliding window, where the different filters are a result of
 // simply changing the coefficients used while processing the samples
@@ -15,7 +23,7 @@
 //   b0, b1, b2, a1, a2      transformation coefficients
 //   xn0, xn1, xn2           the unfiltered sample at position x[n], x[n-1], and x[n-2]
 //   yn1, yn2                the filtered sample at position y[n-1] and y[n-2]
-void sf_biquad_process(sf_biquad_state_st *state, int size, sf_sample_st *input,
+static inline void process_scalar(sf_biquad_state_st *state, int size, sf_sample_st *input,
 	sf_sample_st *output){
 
 	// pull out the state into local variables
@@ -65,6 +73,801 @@ void sf_biquad_process(sf_biquad_state_st *state, int size, sf_sample_st *input,
 	state->yn2 = yn2;
 }
 
+#if defined(__SSE2__)
+// SSE2 version of the same loop
+//
+// a stereo sample is exactly 64 bits, so L and R are loaded into the low two lanes of a register
+// and both channels advance with one instruction per tap
+//
+// the taps are summed in the same order as the scalar loop, so the output is bit-identical to
+// process_scalar (if the compiler fuses the scalar multiply/adds into FMAs, the two paths can
+// differ by 1 ulp per tap)
+//
+// wider registers (AVX2, AVX-512) don't help here, because the yn1/yn2 feedback means there are
+// only ever two independent values in flight
+
+static inline __m128 load_sample(const sf_sample_st *s){
+	return _mm_castpd_ps(_mm_load_sd((const double *)s));
+}
+
+static inline void store_sample(sf_sample_st *s, __m128 v){
+	_mm_store_sd((double *)s, _mm_castps_pd(v));
+}
+
+static void process_sse2(sf_biquad_state_st *state, int size, sf_sample_st *input,
+	sf_sample_st *output){
+
+	// pull out the state into registers
+	__m128 b0 = _mm_set1_ps(state->b0);
+	__m128 b1 = _mm_set1_ps(state->b1);
+	__m128 b2 = _mm_set1_ps(state->b2);
+	__m128 a1 = _mm_set1_ps(state->a1);
+	__m128 a2 = _mm_set1_ps(state->a2);
+	__m128 xn1 = load_sample(&state->xn1);
+	__m128 xn2 = load_sample(&state->xn2);
+	__m128 yn1 = load_sample(&state->yn1);
+	__m128 yn2 = load_sample(&state->yn2);
+
+	for (int n = 0; n < size; n++){
+		__m128 xn0 = load_sample(&input[n]);
+		__m128 yn0 = _mm_mul_ps(b0, xn0);
+		yn0 = _mm_add_ps(yn0, _mm_mul_ps(b1, xn1));
+		yn0 = _mm_add_ps(yn0, _mm_mul_ps(b2, xn2));
+		yn0 = _mm_sub_ps(yn0, _mm_mul_ps(a1, yn1));
+		yn0 = _mm_sub_ps(yn0, _mm_mul_ps(a2, yn2));
+		store_sample(&output[n], yn0);
+		xn2 = xn1;
+		xn1 = xn0;
+		yn2 = yn1;
+		yn1 = yn0;
+	}
+
+	// save the state for future processing
+	store_sample(&state->xn1, xn1);
+	store_sample(&state->xn2, xn2);
+	store_sample(&state->yn1, yn1);
+	store_sample(&state->yn2, yn2);
+}
+#endif
+
+static inline void process(sf_biquad_state_st *state, int size, sf_sample_st *input,
+	sf_sample_st *output){
+#if defined(__SSE2__)
+	process_sse2(state, size, input, output);
+#else
+	process_scalar(state, size, input, output);
+#endif
+}
+
+void sf_biquad_process(sf_biquad_state_st *state, int size, sf_sample_st *input,
+	sf_sample_st *output){
+	sf_denormal_st dn;
+	sf_denormal_begin(&dn);
+	process(state, size, input, output);
+	sf_denormal_end(&dn);
+}
+
+// N-channel sounds are processed a pair of channels at a time, with the samples of each pair
+// `stride` floats apart; a leftover odd channel is processed on its own, using the L half of the
+// state
+static void processn_pair(sf_biquad_state_st *state, int size, int stride, float *input,
+	float *output){
+#if defined(__SSE2__)
+	__m128 b0 = _mm_set1_ps(state->b0);
+	__m128 b1 = _mm_set1_ps(state->b1);
+	__m128 b2 = _mm_set1_ps(state->b2);
+	__m128 a1 = _mm_set1_ps(state->a1);
+	__m128 a2 = _mm_set1_ps(state->a2);
+	__m128 xn1 = load_sample(&state->xn1);
+	__m128 xn2 = load_sample(&state->xn2);
+	__m128 yn1 = load_sample(&state->yn1);
+	__m128 yn2 = load_sample(&state->yn2);
+
+	for (int n = 0; n < size; n++){
+		__m128 xn0 = load_sample((sf_sample_st *)&input[n * stride]);
+		__m128 yn0 = _mm_mul_ps(b0, xn0);
+		yn0 = _mm_add_ps(yn0, _mm_mul_ps(b1, xn1));
+		yn0 = _mm_add_ps(yn0, _mm_mul_ps(b2, xn2));
+		yn0 = _mm_sub_ps(yn0, _mm_mul_ps(a1, yn1));
+		yn0 = _mm_sub_ps(yn0, _mm_mul_ps(a2, yn2));
+		store_sample((sf_sample_st *)&output[n * stride], yn0);
+		xn2 = xn1;
+		xn1 = xn0;
+		yn2 = yn1;
+		yn1 = yn0;
+	}
+
+	store_sample(&state->xn1, xn1);
+	store_sample(&state->xn2, xn2);
+	store_sample(&state->yn1, yn1);
+	store_sample(&state->yn2, yn2);
+#else
+	float b0 = state->b0;
+	float b1 = state->b1;
+	float b2 = state->b2;
+	float a1 = state->a1;
+	float a2 = state->a2;
+	sf_sample_st xn1 = state->xn1;
+	sf_sample_st xn2 = state->xn2;
+	sf_sample_st yn1 = state->yn1;
+	sf_sample_st yn2 = state->yn2;
+
+	for (int n = 0; n < size; n++){
+		sf_sample_st xn0 = { input[n * stride], input[n * stride + 1] };
+		float L =
+			b0 * xn0.L +
+			b1 * xn1.L +
+			b2 * xn2.L -
+			a1 * yn1.L -
+			a2 * yn2.L;
+		float R =
+			b0 * xn0.R +
+			b1 * xn1.R +
+			b2 * xn2.R -
+			a1 * yn1.R -
+			a2 * yn2.R;
+		output[n * stride] = L;
+		output[n * stride + 1] = R;
+		xn2 = xn1;
+		xn1 = xn0;
+		yn2 = yn1;
+		yn1 = (sf_sample_st){ L, R };
+	}
+
+	state->xn1 = xn1;
+	state->xn2 = xn2;
+	state->yn1 = yn1;
+	state->yn2 = yn2;
+#endif
+}
+
+static void processn_single(sf_biquad_state_st *state, int size, int stride, float *input,
+	float *output){
+	float b0 = state->b0;
+	float b1 = state->b1;
+	float b2 = state->b2;
+	float a1 = state->a1;
+	float a2 = state->a2;
+	float xn1 = state->xn1.L;
+	float xn2 = state->xn2.L;
+	float yn1 = state->yn1.L;
+	float yn2 = state->yn2.L;
+
+	for (int n = 0; n < size; n++){
+		float xn0 = input[n * stride];
+		float yn0 =
+			b0 * xn0 +
+			b1 * xn1 +
+			b2 * xn2 -
+			a1 * yn1 -
+			a2 * yn2;
+		output[n * stride] = yn0;
+		xn2 = xn1;
+		xn1 = xn0;
+		yn2 = yn1;
+		yn1 = yn0;
+	}
+
+	state->xn1.L = xn1;
+	state->xn2.L = xn2;
+	state->yn1.L = yn1;
+	state->yn2.L = yn2;
+}
+
+void sf_biquad_processn(sf_biquad_state_st *states, int channels, int size, float *input,
+	float *output){
+	sf_denormal_st dn;
+	sf_denormal_begin(&dn);
+	int c = 0;
+	for (; c + 1 < channels; c += 2)
+		processn_pair(&states[c / 2], size, channels, &input[c], &output[c]);
+	if (c < channels)
+		processn_single(&states[c / 2], size, channels, &input[c], &output[c]);
+	sf_denormal_end(&dn);
+}
+
+// ramping is the same loop, except each coefficient steps by a fixed amount before every sample, so
+// the last sample of the block is filtered with the target coefficients
+static inline void ramp_scalar(sf_biquad_state_st *state, const float *delta, int size,
+	sf_sample_st *input, sf_sample_st *output){
+	float b0 = state->b0;
+	float b1 = state->b1;
+	float b2 = state->b2;
+	float a1 = state->a1;
+	float a2 = state->a2;
+	sf_sample_st xn1 = state->xn1;
+	sf_sample_st xn2 = state->xn2;
+	sf_sample_st yn1 = state->yn1;
+	sf_sample_st yn2 = state->yn2;
+
+	for (int n = 0; n < size; n++){
+		b0 += delta[0];
+		b1 += delta[1];
+		b2 += delta[2];
+		a1 += delta[3];
+		a2 += delta[4];
+		sf_sample_st xn0 = input[n];
+		float L =
+			b0 * xn0.L +
+			b1 * xn1.L +
+			b2 * xn2.L -
+			a1 * yn1.L -
+			a2 * yn2.L;
+		float R =
+			b0 * xn0.R +
+			b1 * xn1.R +
+			b2 * xn2.R -
+			a1 * yn1.R -
+			a2 * yn2.R;
+		output[n] = (sf_sample_st){ L, R };
+		xn2 = xn1;
+		xn1 = xn0;
+		yn2 = yn1;
+		yn1 = output[n];
+	}
+
+	state->xn1 = xn1;
+	state->xn2 = xn2;
+	state->yn1 = yn1;
+	state->yn2 = yn2;
+}
+
+#if defined(__SSE2__)
+// the coefficient steps don't depend on the feedback, so they run alongside it for free
+static void ramp_sse2(sf_biquad_state_st *state, const float *delta, int size,
+	sf_sample_st *input, sf_sample_st *output){
+	__m128 b0 = _mm_set1_ps(state->b0);
+	__m128 b1 = _mm_set1_ps(state->b1);
+	__m128 b2 = _mm_set1_ps(state->b2);
+	__m128 a1 = _mm_set1_ps(state->a1);
+	__m128 a2 = _mm_set1_ps(state->a2);
+	__m128 db0 = _mm_set1_ps(delta[0]);
+	__m128 db1 = _mm_set1_ps(delta[1]);
+	__m128 db2 = _mm_set1_ps(delta[2]);
+	__m128 da1 = _mm_set1_ps(delta[3]);
+	__m128 da2 = _mm_set1_ps(delta[4]);
+	__m128 xn1 = load_sample(&state->xn1);
+	__m128 xn2 = load_sample(&state->xn2);
+	__m128 yn1 = load_sample(&state->yn1);
+	__m128 yn2 = load_sample(&state->yn2);
+
+	for (int n = 0; n < size; n++){
+		b0 = _mm_add_ps(b0, db0);
+		b1 = _mm_add_ps(b1, db1);
+		b2 = _mm_add_ps(b2, db2);
+		a1 = _mm_add_ps(a1, da1);
+		a2 = _mm_add_ps(a2, da2);
+		__m128 xn0 = load_sample(&input[n]);
+		__m128 yn0 = _mm_mul_ps(b0, xn0);
+		yn0 = _mm_add_ps(yn0, _mm_mul_ps(b1, xn1));
+		yn0 = _mm_add_ps(yn0, _mm_mul_ps(b2, xn2));
+		yn0 = _mm_sub_ps(yn0, _mm_mul_ps(a1, yn1));
+		yn0 = _mm_sub_ps(yn0, _mm_mul_ps(a2, yn2));
+		store_sample(&output[n], yn0);
+		xn2 = xn1;
+		xn1 = xn0;
+		yn2 = yn1;
+		yn1 = yn0;
+	}
+
+	store_sample(&state->xn1, xn1);
+	store_sample(&state->xn2, xn2);
+	store_sample(&state->yn1, yn1);
+	store_sample(&state->yn2, yn2);
+}
+#endif
+
+void sf_biquad_ramp_process(sf_biquad_state_st *state, const sf_biquad_state_st *target,
+	int size, sf_sample_st *input, sf_sample_st *output){
+	if (size <= 0)
+		return;
+	float inv = 1.0f / size;
+	float delta[5] = {
+		(target->b0 - state->b0) * inv,
+		(target->b1 - state->b1) * inv,
+		(target->b2 - state->b2) * inv,
+		(target->a1 - state->a1) * inv,
+		(target->a2 - state->a2) * inv
+	};
+	sf_denormal_st dn;
+	sf_denormal_begin(&dn);
+#if defined(__SSE2__)
+	ramp_sse2(state, delta, size, input, output);
+#else
+	ramp_scalar(state, delta, size, input, output);
+#endif
+	sf_denormal_end(&dn);
+	// land exactly on the target, instead of wherever the accumulated steps ended up
+	state->b0 = target->b0;
+	state->b1 = target->b1;
+	state->b2 = target->b2;
+	state->a1 = target->a1;
+	state->a2 = target->a2;
+}
+
+// a cascade runs the sections one after another over small blocks, so the block being worked on
+// stays in L1 while every section gets applied to it
+void sf_biquad_cascade_init(sf_biquad_cascade_st *cascade){
+	cascade->size = 0;
+}
+
+sf_biquad_state_st *sf_biquad_cascade_add(sf_biquad_cascade_st *cascade){
+	if (cascade->size >= SF_BIQUAD_MAXSECTIONS)
+		return NULL;
+	return &cascade->sections[cascade->size++];
+}
+
+void sf_biquad_cascade_process(sf_biquad_cascade_st *cascade, int size, sf_sample_st *input,
+	sf_sample_st *output){
+	if (cascade->size <= 0){
+		// nothing to do, so just pass the sound through
+		if (input != output)
+			memmove(output, input, sizeof(sf_sample_st) * size);
+		return;
+	}
+	sf_denormal_st dn;
+	sf_denormal_begin(&dn);
+	for (int pos = 0; pos < size; pos += SF_BIQUAD_CASCADEBLOCK){
+		int len = size - pos;
+		if (len > SF_BIQUAD_CASCADEBLOCK)
+			len = SF_BIQUAD_CASCADEBLOCK;
+
+		// the first section reads from the input, and the rest work in-place on the output
+		process(&cascade->sections[0], len, &input[pos], &output[pos]);
+		for (int i = 1; i < cascade->size; i++)
+			process(&cascade->sections[i], len, &output[pos], &output[pos]);
+	}
+	sf_denormal_end(&dn);
+}
+
+// look-ahead processing splits the filter into its feedforward part, which has no dependencies
+// between samples:
+//   f[n] = b0 * x[n] + b1 * x[n-1] + b2 * x[n-2]
+// and its feedback part:
+//   y[n] = f[n] - a1 * y[n-1] - a2 * y[n-2]
+//
+// unrolling the feedback for a block of K samples starting at n gives:
+//   y[n+k] = sum(g[j][k] * f[n+j], j = 0..k) + c1[k] * y[n-1] + c2[k] * y[n-2]
+//
+// where g[j][k] is the impulse response of the feedback part, k - j samples after the impulse, and
+// c1/c2 are how the previous two outputs decay over the block -- all of which only depend on a1 and
+// a2, so they are calculated once up front
+void sf_biquad_lookahead(sf_biquad_lookahead_st *la, const sf_biquad_state_st *state){
+	la->state = *state;
+
+	// run the feedback part of the filter for three different starting conditions (in double
+	// precision, so the tables themselves don't add error); the first two slots are y[n-2] and
+	// y[n-1]
+	double a1 = state->a1;
+	double a2 = state->a2;
+	double h [SF_BIQUAD_LOOKAHEAD + 2] = { 0.0, 0.0 }; // impulse response
+	double d1[SF_BIQUAD_LOOKAHEAD + 2] = { 0.0, 1.0 }; // response to y[n-1] = 1
+	double d2[SF_BIQUAD_LOOKAHEAD + 2] = { 1.0, 0.0 }; // response to y[n-2] = 1
+	for (int k = 2; k < SF_BIQUAD_LOOKAHEAD + 2; k++){
+		h [k] = (k == 2 ? 1.0 : 0.0) - a1 * h [k - 1] - a2 * h [k - 2];
+		d1[k] =                       - a1 * d1[k - 1] - a2 * d1[k - 2];
+		d2[k] =                       - a1 * d2[k - 1] - a2 * d2[k - 2];
+	}
+
+	for (int k = 0; k < SF_BIQUAD_LOOKAHEAD; k++){
+		la->c1[k * 2] = la->c1[k * 2 + 1] = (float)d1[k + 2];
+		la->c2[k * 2] = la->c2[k * 2 + 1] = (float)d2[k + 2];
+		for (int j = 0; j < SF_BIQUAD_LOOKAHEAD; j++)
+			la->g[j][k * 2] = la->g[j][k * 2 + 1] = j <= k ? (float)h[k - j + 2] : 0.0f;
+	}
+}
+
+#if defined(__SSE2__)
+// a register holds two stereo samples, so the block is SF_BIQUAD_LOOKAHEAD / 2 registers, each of
+// which is built up one column of g at a time -- none of the multiplies depend on each other, and
+// the only thing carried from block to block is the register holding the last two outputs
+void sf_biquad_lookahead_process(sf_biquad_lookahead_st *la, int size, sf_sample_st *input,
+	sf_sample_st *output){
+	sf_denormal_st dn;
+	sf_denormal_begin(&dn);
+	sf_biquad_state_st *state = &la->state;
+	__m128 b0 = _mm_set1_ps(state->b0);
+	__m128 b1 = _mm_set1_ps(state->b1);
+	__m128 b2 = _mm_set1_ps(state->b2);
+
+	// the history is kept as pairs of samples: the older one in the low half, and the newer one in
+	// the high half
+	__m128 xh = _mm_movelh_ps(load_sample(&state->xn2), load_sample(&state->xn1));
+	__m128 yh = _mm_movelh_ps(load_sample(&state->yn2), load_sample(&state->yn1));
+
+	int n = 0;
+	for (; n + SF_BIQUAD_LOOKAHEAD <= size; n += SF_BIQUAD_LOOKAHEAD){
+		// feedforward part
+		__m128 f[SF_BIQUAD_LOOKAHEAD / 2];
+		for (int r = 0; r < SF_BIQUAD_LOOKAHEAD / 2; r++){
+			__m128 x0 = _mm_loadu_ps(&input[n + r * 2].L);
+			__m128 x1 = _mm_shuffle_ps(xh, x0, _MM_SHUFFLE(1, 0, 3, 2));
+			f[r] = _mm_mul_ps(b0, x0);
+			f[r] = _mm_add_ps(f[r], _mm_mul_ps(b1, x1));
+			f[r] = _mm_add_ps(f[r], _mm_mul_ps(b2, xh));
+			xh = x0;
+		}
+
+		// feedback part
+		__m128 yn1 = _mm_movehl_ps(yh, yh);
+		__m128 yn2 = _mm_movelh_ps(yh, yh);
+		for (int r = 0; r < SF_BIQUAD_LOOKAHEAD / 2; r++){
+			__m128 v = _mm_setzero_ps();
+			for (int j = 0; j < r * 2 + 2; j++){ // g[j][k] is zero for j > k
+				__m128 fj = j & 1 ? _mm_movehl_ps(f[j / 2], f[j / 2]) :
+					_mm_movelh_ps(f[j / 2], f[j / 2]);
+				v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(&la->g[j][r * 4]), fj));
+			}
+			v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(&la->c2[r * 4]), yn2));
+			v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(&la->c1[r * 4]), yn1));
+			_mm_storeu_ps(&output[n + r * 2].L, v);
+			yh = v;
+		}
+	}
+
+	// save the state, and finish any leftover samples the normal way
+	store_sample(&state->xn2, xh);
+	store_sample(&state->xn1, _mm_movehl_ps(xh, xh));
+	store_sample(&state->yn2, yh);
+	store_sample(&state->yn1, _mm_movehl_ps(yh, yh));
+	if (n < size)
+		process(state, size - n, &input[n], &output[n]);
+	sf_denormal_end(&dn);
+}
+#else
+void sf_biquad_lookahead_process(sf_biquad_lookahead_st *la, int size, sf_sample_st *input,
+	sf_sample_st *output){
+	sf_denormal_st dn;
+	sf_denormal_begin(&dn);
+	sf_biquad_state_st *state = &la->state;
+	float b0 = state->b0;
+	float b1 = state->b1;
+	float b2 = state->b2;
+	sf_sample_st xn1 = state->xn1;
+	sf_sample_st xn2 = state->xn2;
+	sf_sample_st yn1 = state->yn1;
+	sf_sample_st yn2 = state->yn2;
+
+	int n = 0;
+	for (; n + SF_BIQUAD_LOOKAHEAD <= size; n += SF_BIQUAD_LOOKAHEAD){
+		// feedforward part
+		float f[SF_BIQUAD_LOOKAHEAD * 2];
+		for (int k = 0; k < SF_BIQUAD_LOOKAHEAD; k++){
+			sf_sample_st xn0 = input[n + k];
+			f[k * 2    ] = b0 * xn0.L + b1 * xn1.L + b2 * xn2.L;
+			f[k * 2 + 1] = b0 * xn0.R + b1 * xn1.R + b2 * xn2.R;
+			xn2 = xn1;
+			xn1 = xn0;
+		}
+
+		// feedback part
+		float y[SF_BIQUAD_LOOKAHEAD * 2] = { 0 };
+		for (int j = 0; j < SF_BIQUAD_LOOKAHEAD; j++){
+			for (int k = j * 2; k < SF_BIQUAD_LOOKAHEAD * 2; k += 2){
+				y[k    ] += la->g[j][k    ] * f[j * 2    ];
+				y[k + 1] += la->g[j][k + 1] * f[j * 2 + 1];
+			}
+		}
+		for (int k = 0; k < SF_BIQUAD_LOOKAHEAD; k++){
+			output[n + k] = (sf_sample_st){
+				y[k * 2    ] + la->c2[k * 2    ] * yn2.L + la->c1[k * 2    ] * yn1.L,
+				y[k * 2 + 1] + la->c2[k * 2 + 1] * yn2.R + la->c1[k * 2 + 1] * yn1.R
+			};
+		}
+
+		// slide everything down one block
+		yn2 = output[n + SF_BIQUAD_LOOKAHEAD - 2];
+		yn1 = output[n + SF_BIQUAD_LOOKAHEAD - 1];
+	}
+
+	// save the state, and finish any leftover samples the normal way
+	state->xn1 = xn1;
+	state->xn2 = xn2;
+	state->yn1 = yn1;
+	state->yn2 = yn2;
+	if (n < size)
+		process(state, size - n, &input[n], &output[n]);
+	sf_denormal_end(&dn);
+}
+#endif
+
+// a batch keeps every stream's values in their own arrays, so the streams can be processed
+// SF_BIQUAD_BATCHLANES at a time using the same formula as above
+sf_biquad_batch sf_biquad_batch_new(int count){
+	if (count < 1)
+		return NULL;
+	sf_biquad_batch batch = sf_malloc(sizeof(sf_biquad_batch_st));
+	if (batch == NULL)
+		return NULL;
+	int lanes = ((count + SF_BIQUAD_BATCHLANES - 1) / SF_BIQUAD_BATCHLANES) *
+		SF_BIQUAD_BATCHLANES;
+	batch->count = count;
+	batch->lanes = lanes;
+	batch->data = sf_malloc(sizeof(float) * 13 * lanes);
+	if (batch->data == NULL){
+		sf_free(batch);
+		return NULL;
+	}
+
+	// unused lanes stay zeroed out, which turns them into silent filters
+	memset(batch->data, 0, sizeof(float) * 13 * lanes);
+	batch->b0   = &batch->data[ 0 * lanes];
+	batch->b1   = &batch->data[ 1 * lanes];
+	batch->b2   = &batch->data[ 2 * lanes];
+	batch->a1   = &batch->data[ 3 * lanes];
+	batch->a2   = &batch->data[ 4 * lanes];
+	batch->xn1L = &batch->data[ 5 * lanes];
+	batch->xn1R = &batch->data[ 6 * lanes];
+	batch->xn2L = &batch->data[ 7 * lanes];
+	batch->xn2R = &batch->data[ 8 * lanes];
+	batch->yn1L = &batch->data[ 9 * lanes];
+	batch->yn1R = &batch->data[10 * lanes];
+	batch->yn2L = &batch->data[11 * lanes];
+	batch->yn2R = &batch->data[12 * lanes];
+	return batch;
+}
+
+void sf_biquad_batch_free(sf_biquad_batch batch){
+	sf_free(batch->data);
+	sf_free(batch);
+}
+
+void sf_biquad_batch_set(sf_biquad_batch batch, int index, const sf_biquad_state_st *state){
+	batch->b0  [index] = state->b0;
+	batch->b1  [index] = state->b1;
+	batch->b2  [index] = state->b2;
+	batch->a1  [index] = state->a1;
+	batch->a2  [index] = state->a2;
+	batch->xn1L[index] = state->xn1.L;
+	batch->xn1R[index] = state->xn1.R;
+	batch->xn2L[index] = state->xn2.L;
+	batch->xn2R[index] = state->xn2.R;
+	batch->yn1L[index] = state->yn1.L;
+	batch->yn1R[index] = state->yn1.R;
+	batch->yn2L[index] = state->yn2.L;
+	batch->yn2R[index] = state->yn2.R;
+}
+
+void sf_biquad_batch_get(sf_biquad_batch batch, int index, sf_biquad_state_st *state){
+	state->b0  = batch->b0[index];
+	state->b1  = batch->b1[index];
+	state->b2  = batch->b2[index];
+	state->a1  = batch->a1[index];
+	state->a2  = batch->a2[index];
+	state->xn1 = (sf_sample_st){ batch->xn1L[index], batch->xn1R[index] };
+	state->xn2 = (sf_sample_st){ batch->xn2L[index], batch->xn2R[index] };
+	state->yn1 = (sf_sample_st){ batch->yn1L[index], batch->yn1R[index] };
+	state->yn2 = (sf_sample_st){ batch->yn2L[index], batch->yn2R[index] };
+}
+
+// the streams are transposed into (and out of) blocks where xL[n] holds sample n of every lane
+//
+// in and out point to the current position of each lane's stream; lanes past the end of the batch
+// point to a zero buffer (in) or a scratch buffer (out), so every lane can be treated the same
+#if defined(__SSE2__)
+// with SSE, a 4x4 tile of stereo samples is moved at a time: each stream's four samples are split
+// into L and R registers, then the four streams are transposed so each register holds one sample
+// of four streams
+static inline void batch_transposein(int len, sf_sample_st **in,
+	float xL[SF_BIQUAD_BATCHBLOCK][SF_BIQUAD_BATCHLANES],
+	float xR[SF_BIQUAD_BATCHBLOCK][SF_BIQUAD_BATCHLANES]){
+	int n = 0;
+	for (; n + 4 <= len; n += 4){
+		for (int i = 0; i < SF_BIQUAD_BATCHLANES; i += 4){
+			__m128 L[4], R[4];
+			for (int k = 0; k < 4; k++){
+				__m128 a = _mm_loadu_ps(&in[i + k][n    ].L); // L0 R0 L1 R1
+				__m128 b = _mm_loadu_ps(&in[i + k][n + 2].L); // L2 R2 L3 R3
+				L[k] = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+				R[k] = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+			}
+			_MM_TRANSPOSE4_PS(L[0], L[1], L[2], L[3]);
+			_MM_TRANSPOSE4_PS(R[0], R[1], R[2], R[3]);
+			for (int k = 0; k < 4; k++){
+				_mm_storeu_ps(&xL[n + k][i], L[k]);
+				_mm_storeu_ps(&xR[n + k][i], R[k]);
+			}
+		}
+	}
+	for (; n < len; n++){
+		for (int i = 0; i < SF_BIQUAD_BATCHLANES; i++){
+			xL[n][i] = in[i][n].L;
+			xR[n][i] = in[i][n].R;
+		}
+	}
+}
+
+static inline void batch_transposeout(int len, sf_sample_st **out,
+	float xL[SF_BIQUAD_BATCHBLOCK][SF_BIQUAD_BATCHLANES],
+	float xR[SF_BIQUAD_BATCHBLOCK][SF_BIQUAD_BATCHLANES]){
+	int n = 0;
+	for (; n + 4 <= len; n += 4){
+		for (int i = 0; i < SF_BIQUAD_BATCHLANES; i += 4){
+			__m128 L[4], R[4];
+			for (int k = 0; k < 4; k++){
+				L[k] = _mm_loadu_ps(&xL[n + k][i]);
+				R[k] = _mm_loadu_ps(&xR[n + k][i]);
+			}
+			_MM_TRANSPOSE4_PS(L[0], L[1], L[2], L[3]);
+			_MM_TRANSPOSE4_PS(R[0], R[1], R[2], R[3]);
+			for (int k = 0; k < 4; k++){
+				_mm_storeu_ps(&out[i + k][n    ].L, _mm_unpacklo_ps(L[k], R[k]));
+				_mm_storeu_ps(&out[i + k][n + 2].L, _mm_unpackhi_ps(L[k], R[k]));
+			}
+		}
+	}
+	for (; n < len; n++){
+		for (int i = 0; i < SF_BIQUAD_BATCHLANES; i++)
+			out[i][n] = (sf_sample_st){ xL[n][i], xR[n][i] };
+	}
+}
+#else
+static inline void batch_transposein(int len, sf_sample_st **in,
+	float xL[SF_BIQUAD_BATCHBLOCK][SF_BIQUAD_BATCHLANES],
+	float xR[SF_BIQUAD_BATCHBLOCK][SF_BIQUAD_BATCHLANES]){
+	for (int n = 0; n < len; n++){
+		for (int i = 0; i < SF_BIQUAD_BATCHLANES; i++){
+			xL[n][i] = in[i][n].L;
+			xR[n][i] = in[i][n].R;
+		}
+	}
+}
+
+static inline void batch_transposeout(int len, sf_sample_st **out,
+	float xL[SF_BIQUAD_BATCHBLOCK][SF_BIQUAD_BATCHLANES],
+	float xR[SF_BIQUAD_BATCHBLOCK][SF_BIQUAD_BATCHLANES]){
+	for (int n = 0; n < len; n++){
+		for (int i = 0; i < SF_BIQUAD_BATCHLANES; i++)
+			out[i][n] = (sf_sample_st){ xL[n][i], xR[n][i] };
+	}
+}
+#endif
+
+// run the filter over a transposed block, overwriting it in place
+#if defined(__SSE2__)
+// four lanes fit in a register, so each group of four lanes is run through the whole block while
+// its coefficients and history stay in registers
+static inline void batch_filter(int len, float *b0, float *b1, float *b2, float *a1, float *a2,
+	float *xn1L, float *xn1R, float *xn2L, float *xn2R, float *yn1L, float *yn1R, float *yn2L,
+	float *yn2R, float xL[SF_BIQUAD_BATCHBLOCK][SF_BIQUAD_BATCHLANES],
+	float xR[SF_BIQUAD_BATCHBLOCK][SF_BIQUAD_BATCHLANES]){
+	for (int i = 0; i < SF_BIQUAD_BATCHLANES; i += 4){
+		__m128 vb0 = _mm_loadu_ps(&b0[i]);
+		__m128 vb1 = _mm_loadu_ps(&b1[i]);
+		__m128 vb2 = _mm_loadu_ps(&b2[i]);
+		__m128 va1 = _mm_loadu_ps(&a1[i]);
+		__m128 va2 = _mm_loadu_ps(&a2[i]);
+		__m128 vxn1L = _mm_loadu_ps(&xn1L[i]), vxn1R = _mm_loadu_ps(&xn1R[i]);
+		__m128 vxn2L = _mm_loadu_ps(&xn2L[i]), vxn2R = _mm_loadu_ps(&xn2R[i]);
+		__m128 vyn1L = _mm_loadu_ps(&yn1L[i]), vyn1R = _mm_loadu_ps(&yn1R[i]);
+		__m128 vyn2L = _mm_loadu_ps(&yn2L[i]), vyn2R = _mm_loadu_ps(&yn2R[i]);
+		for (int n = 0; n < len; n++){
+			__m128 vxn0L = _mm_loadu_ps(&xL[n][i]);
+			__m128 vxn0R = _mm_loadu_ps(&xR[n][i]);
+			__m128 L = _mm_mul_ps(vb0, vxn0L);
+			__m128 R = _mm_mul_ps(vb0, vxn0R);
+			L = _mm_add_ps(L, _mm_mul_ps(vb1, vxn1L));
+			R = _mm_add_ps(R, _mm_mul_ps(vb1, vxn1R));
+			L = _mm_add_ps(L, _mm_mul_ps(vb2, vxn2L));
+			R = _mm_add_ps(R, _mm_mul_ps(vb2, vxn2R));
+			L = _mm_sub_ps(L, _mm_mul_ps(va1, vyn1L));
+			R = _mm_sub_ps(R, _mm_mul_ps(va1, vyn1R));
+			L = _mm_sub_ps(L, _mm_mul_ps(va2, vyn2L));
+			R = _mm_sub_ps(R, _mm_mul_ps(va2, vyn2R));
+			_mm_storeu_ps(&xL[n][i], L);
+			_mm_storeu_ps(&xR[n][i], R);
+			vxn2L = vxn1L; vxn2R = vxn1R;
+			vxn1L = vxn0L; vxn1R = vxn0R;
+			vyn2L = vyn1L; vyn2R = vyn1R;
+			vyn1L = L;     vyn1R = R;
+		}
+		_mm_storeu_ps(&xn1L[i], vxn1L); _mm_storeu_ps(&xn1R[i], vxn1R);
+		_mm_storeu_ps(&xn2L[i], vxn2L); _mm_storeu_ps(&xn2R[i], vxn2R);
+		_mm_storeu_ps(&yn1L[i], vyn1L); _mm_storeu_ps(&yn1R[i], vyn1R);
+		_mm_storeu_ps(&yn2L[i], vyn2L); _mm_storeu_ps(&yn2R[i], vyn2R);
+	}
+}
+#else
+// without SSE, the loop is written so there are no dependencies between lanes in the inner loop,
+// which lets the compiler vectorize it for whatever instruction set it's targeting
+static inline void batch_filter(int len, float *b0, float *b1, float *b2, float *a1, float *a2,
+	float *xn1L, float *xn1R, float *xn2L, float *xn2R, float *yn1L, float *yn1R, float *yn2L,
+	float *yn2R, float xL[SF_BIQUAD_BATCHBLOCK][SF_BIQUAD_BATCHLANES],
+	float xR[SF_BIQUAD_BATCHBLOCK][SF_BIQUAD_BATCHLANES]){
+	for (int n = 0; n < len; n++){
+		for (int i = 0; i < SF_BIQUAD_BATCHLANES; i++){
+			float L =
+				b0[i] * xL[n][i] +
+				b1[i] * xn1L[i] +
+				b2[i] * xn2L[i] -
+				a1[i] * yn1L[i] -
+				a2[i] * yn2L[i];
+			float R =
+				b0[i] * xR[n][i] +
+				b1[i] * xn1R[i] +
+				b2[i] * xn2R[i] -
+				a1[i] * yn1R[i] -
+				a2[i] * yn2R[i];
+			xn2L[i] = xn1L[i];
+			xn2R[i] = xn1R[i];
+			xn1L[i] = xL[n][i];
+			xn1R[i] = xR[n][i];
+			yn2L[i] = yn1L[i];
+			yn2R[i] = yn1R[i];
+			yn1L[i] = L;
+			yn1R[i] = R;
+			xL[n][i] = L;
+			xR[n][i] = R;
+		}
+	}
+}
+#endif
+
+void sf_biquad_batch_process(sf_biquad_batch batch, int size, sf_sample_st **input,
+	sf_sample_st **output){
+	sf_denormal_st dn;
+	sf_denormal_begin(&dn);
+	float xL[SF_BIQUAD_BATCHBLOCK][SF_BIQUAD_BATCHLANES];
+	float xR[SF_BIQUAD_BATCHBLOCK][SF_BIQUAD_BATCHLANES];
+	sf_sample_st zero[SF_BIQUAD_BATCHBLOCK] = {{ 0 }};
+	sf_sample_st scratch[SF_BIQUAD_BATCHBLOCK];
+
+	for (int lane0 = 0; lane0 < batch->lanes; lane0 += SF_BIQUAD_BATCHLANES){
+		// pull out the state of this group of lanes into local variables
+		float b0[SF_BIQUAD_BATCHLANES], b1[SF_BIQUAD_BATCHLANES], b2[SF_BIQUAD_BATCHLANES];
+		float a1[SF_BIQUAD_BATCHLANES], a2[SF_BIQUAD_BATCHLANES];
+		float xn1L[SF_BIQUAD_BATCHLANES], xn1R[SF_BIQUAD_BATCHLANES];
+		float xn2L[SF_BIQUAD_BATCHLANES], xn2R[SF_BIQUAD_BATCHLANES];
+		float yn1L[SF_BIQUAD_BATCHLANES], yn1R[SF_BIQUAD_BATCHLANES];
+		float yn2L[SF_BIQUAD_BATCHLANES], yn2R[SF_BIQUAD_BATCHLANES];
+		size_t bytes = sizeof(float) * SF_BIQUAD_BATCHLANES;
+		memcpy(b0  , &batch->b0  [lane0], bytes);
+		memcpy(b1  , &batch->b1  [lane0], bytes);
+		memcpy(b2  , &batch->b2  [lane0], bytes);
+		memcpy(a1  , &batch->a1  [lane0], bytes);
+		memcpy(a2  , &batch->a2  [lane0], bytes);
+		memcpy(xn1L, &batch->xn1L[lane0], bytes);
+		memcpy(xn1R, &batch->xn1R[lane0], bytes);
+		memcpy(xn2L, &batch->xn2L[lane0], bytes);
+		memcpy(xn2R, &batch->xn2R[lane0], bytes);
+		memcpy(yn1L, &batch->yn1L[lane0], bytes);
+		memcpy(yn1R, &batch->yn1R[lane0], bytes);
+		memcpy(yn2L, &batch->yn2L[lane0], bytes);
+		memcpy(yn2R, &batch->yn2R[lane0], bytes);
+
+		for (int pos = 0; pos < size; pos += SF_BIQUAD_BATCHBLOCK){
+			int len = size - pos;
+			if (len > SF_BIQUAD_BATCHBLOCK)
+				len = SF_BIQUAD_BATCHBLOCK;
+
+			sf_sample_st *in[SF_BIQUAD_BATCHLANES], *out[SF_BIQUAD_BATCHLANES];
+			for (int i = 0; i < SF_BIQUAD_BATCHLANES; i++){
+				bool used = lane0 + i < batch->count;
+				in [i] = used ? &input [lane0 + i][pos] : zero;
+				out[i] = used ? &output[lane0 + i][pos] : scratch;
+			}
+
+			batch_transposein(len, in, xL, xR);
+
+			batch_filter(len, b0, b1, b2, a1, a2, xn1L, xn1R, xn2L, xn2R, yn1L, yn1R, yn2L, yn2R,
+				xL, xR);
+
+			batch_transposeout(len, out, xL, xR);
+		}
+
+		// save the state for future processing
+		memcpy(&batch->xn1L[lane0], xn1L, bytes);
+		memcpy(&batch->xn1R[lane0], xn1R, bytes);
+		memcpy(&batch->xn2L[lane0], xn2L, bytes);
+		memcpy(&batch->xn2R[lane0], xn2R, bytes);
+		memcpy(&batch->yn1L[lane0], yn1L, bytes);
+		memcpy(&batch->yn1R[lane0], yn1R, bytes);
+		memcpy(&batch->yn2L[lane0], yn2L, bytes);
+		memcpy(&batch->yn2R[lane0], yn2R, bytes);
+	}
+	sf_denormal_end(&dn);
+}
+
 // each type of filter just has some magic math to setup the coefficients
 //
 // the math is quite complicated to understand, but the *implementation* is quite simple
@@ -103,9 +906,10 @@ static inline void state_zero(sf_biquad_state_st *state){
 	state_scale(state, 0.0f);
 }
 
-// initialize the biquad state to be a lowpass filter
-void sf_lowpass(sf_biquad_state_st *state, int rate, float cutoff, float resonance){
-	state_reset(state);
+// the design_* functions only set the coefficients, and leave the history alone
+
+// set the coefficients for a lowpass filter
+static void design_lowpass(sf_biquad_state_st *state, int rate, float cutoff, float resonance){
 	float nyquist = rate * 0.5f;
 	cutoff /= nyquist;
 
@@ -128,8 +932,7 @@ void sf_lowpass(sf_biquad_state_st *state, int rate, float cutoff, float resonan
 	}
 }
 
-void sf_highpass(sf_biquad_state_st *state, int rate, float cutoff, float resonance){
-	state_reset(state);
+static void design_highpass(sf_biquad_state_st *state, int rate, float cutoff, float resonance){
 	float nyquist = rate * 0.5f;
 	cutoff /= nyquist;
 
@@ -152,8 +955,7 @@ void sf_highpass(sf_biquad_state_st *state, int rate, float cutoff, float resona
 	}
 }
 
-void sf_bandpass(sf_biquad_state_st *state, int rate, float freq, float Q){
-	state_reset(state);
+static void design_bandpass(sf_biquad_state_st *state, int rate, float freq, float Q){
 	float nyquist = rate * 0.5f;
 	freq /= nyquist;
 
@@ -174,8 +976,7 @@ void sf_bandpass(sf_biquad_state_st *state, int rate, float freq, float Q){
 	}
 }
 
-void sf_notch(sf_biquad_state_st *state, int rate, float freq, float Q){
-	state_reset(state);
+static void design_notch(sf_biquad_state_st *state, int rate, float freq, float Q){
 	float nyquist = rate * 0.5f;
 	freq /= nyquist;
 
@@ -196,8 +997,7 @@ void sf_notch(sf_biquad_state_st *state, int rate, float freq, float Q){
 	}
 }
 
-void sf_peaking(sf_biquad_state_st *state, int rate, float freq, float Q, float gain){
-	state_reset(state);
+static void design_peaking(sf_biquad_state_st *state, int rate, float freq, float Q, float gain){
 	float nyquist = rate * 0.5f;
 	freq /= nyquist;
 
@@ -224,8 +1024,7 @@ void sf_peaking(sf_biquad_state_st *state, int rate, float freq, float Q, float
 	state->a2 = a0inv * (1.0f - alpha / A);
 }
 
-void sf_allpass(sf_biquad_state_st *state, int rate, float freq, float Q){
-	state_reset(state);
+static void design_allpass(sf_biquad_state_st *state, int rate, float freq, float Q){
 	float nyquist = rate * 0.5f;
 	freq /= nyquist;
 
@@ -247,8 +1046,7 @@ void sf_allpass(sf_biquad_state_st *state, int rate, float freq, float Q){
 }
 
 // WebAudio hardcodes Q=1
-void sf_lowshelf(sf_biquad_state_st *state, int rate, float freq, float Q, float gain){
-	state_reset(state);
+static void design_lowshelf(sf_biquad_state_st *state, int rate, float freq, float Q, float gain){
 	float nyquist = rate * 0.5f;
 	freq /= nyquist;
 
@@ -282,8 +1080,7 @@ void sf_lowshelf(sf_biquad_state_st *state, int rate, float freq, float Q, float
 }
 
 // WebAudio hardcodes Q=1
-void sf_highshelf(sf_biquad_state_st *state, int rate, float freq, float Q, float gain){
-	state_reset(state);
+static void design_highshelf(sf_biquad_state_st *state, int rate, float freq, float Q, float gain){
 	float nyquist = rate * 0.5f;
 	freq /= nyquist;
 
@@ -315,3 +1112,315 @@ void sf_highshelf(sf_biquad_state_st *state, int rate, float freq, float Q, floa
 	state->a1 = a0inv * 2.0f * (Am1 - Ap1 * k);
 	state->a2 = a0inv * (Ap1 - Am1 * k - k2);
 }
+
+// set the coefficients for any type of filter
+static void design(sf_biquad_state_st *state, sf_biquad_type type, int rate, float freq, float Q,
+	float gain){
+	switch (type){
+		case SF_BIQUAD_LOWPASS  : design_lowpass  (state, rate, freq, Q);       break;
+		case SF_BIQUAD_HIGHPASS : design_highpass (state, rate, freq, Q);       break;
+		case SF_BIQUAD_BANDPASS : design_bandpass (state, rate, freq, Q);       break;
+		case SF_BIQUAD_NOTCH    : design_notch    (state, rate, freq, Q);       break;
+		case SF_BIQUAD_PEAKING  : design_peaking  (state, rate, freq, Q, gain); break;
+		case SF_BIQUAD_ALLPASS  : design_allpass  (state, rate, freq, Q);       break;
+		case SF_BIQUAD_LOWSHELF : design_lowshelf (state, rate, freq, Q, gain); break;
+		case SF_BIQUAD_HIGHSHELF: design_highshelf(state, rate, freq, Q, gain); break;
+	}
+}
+
+void sf_lowpass(sf_biquad_state_st *state, int rate, float cutoff, float resonance){
+	state_reset(state);
+	design_lowpass(state, rate, cutoff, resonance);
+}
+
+void sf_highpass(sf_biquad_state_st *state, int rate, float cutoff, float resonance){
+	state_reset(state);
+	design_highpass(state, rate, cutoff, resonance);
+}
+
+void sf_bandpass(sf_biquad_state_st *state, int rate, float freq, float Q){
+	state_reset(state);
+	design_bandpass(state, rate, freq, Q);
+}
+
+void sf_notch(sf_biquad_state_st *state, int rate, float freq, float Q){
+	state_reset(state);
+	design_notch(state, rate, freq, Q);
+}
+
+void sf_peaking(sf_biquad_state_st *state, int rate, float freq, float Q, float gain){
+	state_reset(state);
+	design_peaking(state, rate, freq, Q, gain);
+}
+
+void sf_allpass(sf_biquad_state_st *state, int rate, float freq, float Q){
+	state_reset(state);
+	design_allpass(state, rate, freq, Q);
+}
+
+void sf_lowshelf(sf_biquad_state_st *state, int rate, float freq, float Q, float gain){
+	state_reset(state);
+	design_lowshelf(state, rate, freq, Q, gain);
+}
+
+void sf_highshelf(sf_biquad_state_st *state, int rate, float freq, float Q, float gain){
+	state_reset(state);
+	design_highshelf(state, rate, freq, Q, gain);
+}
+
+void sf_biquad_design(sf_biquad_state_st *state, sf_biquad_type type, int rate, float freq,
+	float Q, float gain){
+	state_reset(state);
+	design(state, type, rate, freq, Q, gain);
+}
+
+void sf_biquad_retune(sf_biquad_state_st *state, sf_biquad_type type, int rate, float freq,
+	float Q, float gain){
+	design(state, type, rate, freq, Q, gain);
+}
+
+// coefficient cache
+
+// the bits of a float, used for hashing and for rounding away low mantissa bits
+static inline uint32_t float_bits(float f){
+	uint32_t u;
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+static inline float bits_float(uint32_t u){
+	float f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+// round a float to the nearest value that has `bits` mantissa bits; rounding the bit pattern works
+// across exponent boundaries (the carry moves into the exponent), and leaves 0, inf and NaN alone
+static inline float quantize(float f, int bits){
+	int drop = 23 - bits;
+	if (drop <= 0)
+		return f;
+	uint32_t u = float_bits(f);
+	if ((u & 0x7F800000) == 0x7F800000) // inf or NaN
+		return f;
+	u = (u + (1u << (drop - 1))) & ~((1u << drop) - 1);
+	return bits_float(u);
+}
+
+sf_biquad_cache sf_biquad_cache_new(int size, int bits){
+	// round the size up to a power of 2 with room for at least one set
+	int sets = 1;
+	while (sets * SF_BIQUAD_CACHEWAYS < size){
+		if (sets >= (1 << 24))
+			return NULL;
+		sets <<= 1;
+	}
+	sf_biquad_cache cache = sf_malloc(sizeof(sf_biquad_cache_st));
+	if (cache == NULL)
+		return NULL;
+	cache->entries = sf_malloc(sizeof(sf_biquad_cache_entry_st) * sets * SF_BIQUAD_CACHEWAYS);
+	if (cache->entries == NULL){
+		sf_free(cache);
+		return NULL;
+	}
+	if (bits < 1)
+		bits = 1;
+	else if (bits > 23)
+		bits = 23;
+	cache->size = sets * SF_BIQUAD_CACHEWAYS;
+	cache->bits = bits;
+	cache->hits = 0;
+	cache->misses = 0;
+	for (int i = 0; i < cache->size; i++)
+		cache->entries[i].type = -1;
+	return cache;
+}
+
+void sf_biquad_cache_free(sf_biquad_cache cache){
+	sf_free(cache->entries);
+	sf_free(cache);
+}
+
+// find the coefficients of a design in the cache, designing them on a miss
+static const sf_biquad_cache_entry_st *cache_lookup(sf_biquad_cache cache,
+	sf_biquad_type type, int rate, float freq, float Q, float gain){
+	freq = quantize(freq, cache->bits);
+	Q    = quantize(Q   , cache->bits);
+	// gain is ignored by everything except peaking and shelving filters, so it shouldn't cause
+	// otherwise identical designs to miss
+	if (type == SF_BIQUAD_PEAKING || type == SF_BIQUAD_LOWSHELF || type == SF_BIQUAD_HIGHSHELF)
+		gain = quantize(gain, cache->bits);
+	else
+		gain = 0;
+
+	uint32_t fb = float_bits(freq);
+	uint32_t qb = float_bits(Q);
+	uint32_t gb = float_bits(gain);
+	uint32_t h = (uint32_t)type * 0x9E3779B1u;
+	h = (h ^ (uint32_t)rate) * 0x85EBCA77u;
+	h = (h ^ fb) * 0xC2B2AE3Du;
+	h = (h ^ qb) * 0x27D4EB2Fu;
+	h = (h ^ gb) * 0x165667B1u;
+	h ^= h >> 15;
+	sf_biquad_cache_entry_st *set =
+		&cache->entries[(h & (cache->size / SF_BIQUAD_CACHEWAYS - 1)) * SF_BIQUAD_CACHEWAYS];
+
+	for (int i = 0; i < SF_BIQUAD_CACHEWAYS; i++){
+		sf_biquad_cache_entry_st *e = &set[i];
+		if (e->type == (int)type && e->rate == rate && float_bits(e->freq) == fb &&
+			float_bits(e->Q) == qb && float_bits(e->gain) == gb){
+			cache->hits++;
+			return e;
+		}
+	}
+
+	// miss, so design the quantized parameters and replace one of the entries in the set (picked
+	// round robin); designing the quantized values (instead of the requested ones) means the result
+	// doesn't depend on which nearby request happened to fill the entry first
+	sf_biquad_cache_entry_st *e = &set[cache->misses & (SF_BIQUAD_CACHEWAYS - 1)];
+	cache->misses++;
+	sf_biquad_state_st st;
+	design(&st, type, rate, freq, Q, gain);
+	e->type = type;
+	e->rate = rate;
+	e->freq = freq;
+	e->Q    = Q;
+	e->gain = gain;
+	e->b0   = st.b0;
+	e->b1   = st.b1;
+	e->b2   = st.b2;
+	e->a1   = st.a1;
+	e->a2   = st.a2;
+	return e;
+}
+
+void sf_biquad_cache_design(sf_biquad_cache cache, sf_biquad_state_st *state,
+	sf_biquad_type type, int rate, float freq, float Q, float gain){
+	state_reset(state);
+	sf_biquad_cache_retune(cache, state, type, rate, freq, Q, gain);
+}
+
+void sf_biquad_cache_retune(sf_biquad_cache cache, sf_biquad_state_st *state,
+	sf_biquad_type type, int rate, float freq, float Q, float gain){
+	const sf_biquad_cache_entry_st *e = cache_lookup(cache, type, rate, freq, Q, gain);
+	state->b0 = e->b0;
+	state->b1 = e->b1;
+	state->b2 = e->b2;
+	state->a1 = e->a1;
+	state->a2 = e->a2;
+}
+
+// fixed-point
+
+// round a coefficient to fixed-point with `shift` fractional bits
+static inline int32_t fixed(float v, int shift){
+	return (int32_t)lrint(ldexp(v, shift));
+}
+
+bool sf_biquad16(sf_biquad16_st *st, const sf_biquad_state_st *state){
+	float c[5] = { state->b0, state->b1, state->b2, state->a1, state->a2 };
+	float big = 0;
+	for (int i = 0; i < 5; i++){
+		if (!(fabsf(c[i]) < 16.0f)) // also catches NaN
+			return false;
+		if (fabsf(c[i]) > big)
+			big = fabsf(c[i]);
+	}
+	// leave room for the rounding to land on the upper bound
+	st->shift = big < 3.999999f ? 29 : 27;
+	st->b0 = fixed(c[0], st->shift);
+	st->b1 = fixed(c[1], st->shift);
+	st->b2 = fixed(c[2], st->shift);
+	st->a1 = fixed(c[3], st->shift);
+	st->a2 = fixed(c[4], st->shift);
+	st->xn1 = (sf_sample16_st){ 0, 0 };
+	st->xn2 = (sf_sample16_st){ 0, 0 };
+	st->yn1L = 0;
+	st->yn1R = 0;
+	st->yn2L = 0;
+	st->yn2R = 0;
+	st->en1L = 0;
+	st->en1R = 0;
+	st->en2L = 0;
+	st->en2R = 0;
+	return true;
+}
+
+// round the accumulator to the output's scale; the bits rounded off are saved in *err
+static inline int32_t fixed_round(int64_t acc, int shift, int64_t *err){
+	int64_t y = (acc + ((int64_t)1 << (shift - 1))) >> shift;
+	if (y > INT32_MAX || y < INT32_MIN){
+		// only an unstable filter can get here, so don't bother tracking the error
+		*err = 0;
+		return y > INT32_MAX ? INT32_MAX : INT32_MIN;
+	}
+	*err = acc - (y << shift);
+	return (int32_t)y;
+}
+
+static inline int16_t saturate16(int32_t v){
+	return v > 32767 ? 32767 : (v < -32768 ? -32768 : (int16_t)v);
+}
+
+void sf_biquad16_process(sf_biquad16_st *st, int size, sf_sample16_st *input,
+	sf_sample16_st *output){
+
+	// pull out the state into local variables
+	int64_t b0 = st->b0;
+	int64_t b1 = st->b1;
+	int64_t b2 = st->b2;
+	int64_t a1 = st->a1;
+	int64_t a2 = st->a2;
+	int shift = st->shift;
+	sf_sample16_st xn1 = st->xn1;
+	sf_sample16_st xn2 = st->xn2;
+	int64_t yn1L = st->yn1L;
+	int64_t yn1R = st->yn1R;
+	int64_t yn2L = st->yn2L;
+	int64_t yn2R = st->yn2R;
+	int64_t en1L = st->en1L;
+	int64_t en1R = st->en1R;
+	int64_t en2L = st->en2L;
+	int64_t en2R = st->en2R;
+
+	for (int n = 0; n < size; n++){
+		sf_sample16_st xn0 = input[n];
+		// the rounding error of the previous outputs goes through the feedback too, which is the
+		// same as if the history were kept with `shift` extra bits of precision
+		int64_t L = -((a1 * en1L + a2 * en2L) >> shift) +
+			b0 * xn0.L +
+			b1 * xn1.L +
+			b2 * xn2.L -
+			a1 * yn1L -
+			a2 * yn2L;
+		int64_t R = -((a1 * en1R + a2 * en2R) >> shift) +
+			b0 * xn0.R +
+			b1 * xn1.R +
+			b2 * xn2.R -
+			a1 * yn1R -
+			a2 * yn2R;
+		en2L = en1L;
+		en2R = en1R;
+		int32_t yn0L = fixed_round(L, shift, &en1L);
+		int32_t yn0R = fixed_round(R, shift, &en1R);
+		output[n] = (sf_sample16_st){ saturate16(yn0L), saturate16(yn0R) };
+		xn2 = xn1;
+		xn1 = xn0;
+		yn2L = yn1L;
+		yn2R = yn1R;
+		yn1L = yn0L;
+		yn1R = yn0R;
+	}
+
+	// save the state for future processing
+	st->xn1 = xn1;
+	st->xn2 = xn2;
+	st->yn1L = yn1L;
+	st->yn1R = yn1R;
+	st->yn2L = yn2L;
+	st->yn2R = yn2R;
+	st->en1L = en1L;
+	st->en1R = en1R;
+	st->en2L = en2L;
+	st->en2R = en2R;
+}
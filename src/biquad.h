@@ -54,9 +54,318 @@ void sf_allpass  (sf_biquad_state_st *state, int rate, float freq, float Q);
 void sf_lowshelf (sf_biquad_state_st *state, int rate, float freq, float Q, float gain);
 void sf_highshelf(sf_biquad_state_st *state, int rate, float freq, float Q, float gain);
 
+// the same designs, selected by type; the lowpass and highpass filters use Q as the resonance, and
+// only the peaking and shelving filters use gain
+typedef enum {
+	SF_BIQUAD_LOWPASS,
+	SF_BIQUAD_HIGHPASS,
+	SF_BIQUAD_BANDPASS,
+	SF_BIQUAD_NOTCH,
+	SF_BIQUAD_PEAKING,
+	SF_BIQUAD_ALLPASS,
+	SF_BIQUAD_LOWSHELF,
+	SF_BIQUAD_HIGHSHELF
+} sf_biquad_type;
+
+void sf_biquad_design(sf_biquad_state_st *state, sf_biquad_type type, int rate, float freq,
+	float Q, float gain);
+
+// same as sf_biquad_design, except only the coefficients are changed, and the history is kept, so
+// the filter can be changed while a stream is running without a click from the history being wiped
+void sf_biquad_retune(sf_biquad_state_st *state, sf_biquad_type type, int rate, float freq,
+	float Q, float gain);
+
 // this function will process the input sound based on the state passed
 // the input and output buffers should be the same size
 void sf_biquad_process(sf_biquad_state_st *state, int size, sf_sample_st *input,
 	sf_sample_st *output);
 
+// N-channel processing
+//
+// for an sf_sndn_st sound, the channels are filtered in pairs, with one state per pair, so the
+// states array needs (channels + 1) / 2 entries; for a mono sound, only the L half of the single
+// state is used, which is half the work of filtering the same sound duplicated into stereo:
+//
+//   sf_biquad_state_st lowpass[(SF_SND_MAXCHANNELS + 1) / 2];
+//   for each pair:
+//     sf_lowpass(&lowpass[pair], 44100, 440, 1);
+//
+//   for each 128 length sample:
+//     sf_biquad_processn(lowpass, snd->channels, 128, input, output);
+//
+// input and output point to interleaved samples, and the channel count should stay the same for
+// the life of the states; for stereo the output is identical to sf_biquad_process
+void sf_biquad_processn(sf_biquad_state_st *states, int channels, int size, float *input,
+	float *output);
+
+// ramping
+//
+// retuning a filter between chunks changes the coefficients all at once, which can be heard as a
+// zipper noise when the filter is swept; instead of redesigning the filter for every sample, the
+// filter can be designed once per chunk, and the coefficients are ramped linearly to it:
+//
+//   sf_biquad_state_st lowpass;
+//   sf_lowpass(&lowpass, 48000, 440, 1);
+//
+//   for each 64 length sample:
+//     sf_biquad_state_st target;
+//     sf_biquad_retune(&target, SF_BIQUAD_LOWPASS, 48000, cutoff, 1, 0);
+//     sf_biquad_ramp_process(&lowpass, &target, 64, input, output);
+//
+// only the coefficients of the target are used; the coefficients step evenly from the state's
+// current ones so that the last sample of the chunk uses the target's, and afterwards the state
+// has the target's coefficients
+//
+// the a1/a2 values of stable biquads form a triangle, so a straight line between two stable
+// filters stays stable the whole way
+void sf_biquad_ramp_process(sf_biquad_state_st *state, const sf_biquad_state_st *target,
+	int size, sf_sample_st *input, sf_sample_st *output);
+
+// cascades
+//
+// an EQ is usually several biquad sections in series; calling sf_biquad_process for each section
+// means the whole buffer is streamed through the cache once per section
+//
+// a cascade holds up to SF_BIQUAD_MAXSECTIONS sections, and runs every section over a small block
+// before moving to the next block, so the intermediate signal stays in the L1 cache
+//
+// sections are added with sf_biquad_cascade_add, which returns a state to initialize with any of
+// the functions above (it returns NULL if the cascade is full):
+//
+//   sf_biquad_cascade_st eq;
+//   sf_biquad_cascade_init(&eq);
+//   sf_lowshelf (sf_biquad_cascade_add(&eq), 44100,  200, 1,  3);
+//   sf_peaking  (sf_biquad_cascade_add(&eq), 44100, 1000, 1, -2);
+//   sf_highshelf(sf_biquad_cascade_add(&eq), 44100, 8000, 1,  4);
+//
+//   for each 128 length sample:
+//     sf_biquad_cascade_process(&eq, 128, input, output);
+//
+// the output is identical to calling sf_biquad_process on each section in order
+
+// maximum number of sections in a cascade
+#define SF_BIQUAD_MAXSECTIONS    16
+
+// number of samples run through all the sections at a time
+#define SF_BIQUAD_CASCADEBLOCK   256
+
+typedef struct {
+	int size; // number of sections in use
+	sf_biquad_state_st sections[SF_BIQUAD_MAXSECTIONS];
+} sf_biquad_cascade_st;
+
+void                sf_biquad_cascade_init(sf_biquad_cascade_st *cascade);
+sf_biquad_state_st *sf_biquad_cascade_add(sf_biquad_cascade_st *cascade);
+void                sf_biquad_cascade_process(sf_biquad_cascade_st *cascade, int size,
+	sf_sample_st *input, sf_sample_st *output);
+
+// look-ahead processing
+//
+// the yn1/yn2 feedback means every output sample has to wait for the one before it, which limits
+// how fast a single stream can be filtered; for offline work, the recurrence can be unrolled so
+// that a block of SF_BIQUAD_LOOKAHEAD outputs only depends on the two outputs before the block:
+//
+//   sf_biquad_state_st lowpass;
+//   sf_lowpass(&lowpass, 44100, 440, 1);
+//
+//   sf_biquad_lookahead_st la;
+//   sf_biquad_lookahead(&la, &lowpass);
+//
+//   for each 128 length sample:
+//     sf_biquad_lookahead_process(&la, 128, input, output);
+//
+// the output matches sf_biquad_process up to float rounding, because the same math is performed in
+// a different order; the rounding noise is a few dB higher than sf_biquad_process (for a 1kHz
+// peaking filter at 48kHz, both are around -110dB relative to the signal), and like
+// sf_biquad_process it grows for low frequency filters, whose poles are close to the unit circle
+
+// number of samples computed independently of each other (must be even)
+#define SF_BIQUAD_LOOKAHEAD      4
+
+// the tables are stored with each value repeated for the L and R channel, which lets the stereo
+// samples be processed in place
+typedef struct {
+	sf_biquad_state_st state;             // coefficients and history
+	float c1[SF_BIQUAD_LOOKAHEAD * 2];    // contribution of y[n-1] to each output in the block
+	float c2[SF_BIQUAD_LOOKAHEAD * 2];    // contribution of y[n-2] to each output in the block
+	float g[SF_BIQUAD_LOOKAHEAD][SF_BIQUAD_LOOKAHEAD * 2]; // contribution of each feedforward value
+} sf_biquad_lookahead_st;
+
+// initialize look-ahead processing from a state created by the functions above
+void sf_biquad_lookahead(sf_biquad_lookahead_st *la, const sf_biquad_state_st *state);
+
+// process the input sound; the input and output buffers should be the same size
+void sf_biquad_lookahead_process(sf_biquad_lookahead_st *la, int size, sf_sample_st *input,
+	sf_sample_st *output);
+
+// batches
+//
+// when processing many independent streams, each with its own filter, a batch stores the
+// coefficients and history of every stream in structure-of-arrays form, so that the same tap of
+// several streams is computed with a single SIMD instruction
+//
+// for example, for 256 streams that each have their own lowpass:
+//
+//   sf_biquad_batch batch = sf_biquad_batch_new(256);
+//   for each stream i:
+//     sf_biquad_state_st lowpass;
+//     sf_lowpass(&lowpass, 48000, cutoff[i], 1);
+//     sf_biquad_batch_set(batch, i, &lowpass);
+//
+//   for each 128 length sample:
+//     sf_biquad_batch_process(batch, 128, inputs, outputs);
+//
+// where inputs and outputs are arrays of 256 pointers to each stream's 128 samples
+//
+// each stream's output is identical to running sf_biquad_process on it individually
+
+// number of streams processed together; should be a multiple of the widest SIMD register
+#define SF_BIQUAD_BATCHLANES     16
+
+// number of samples transposed into the batch layout at a time
+#define SF_BIQUAD_BATCHBLOCK     32
+
+typedef struct {
+	int count; // number of streams
+	int lanes; // count rounded up to a multiple of SF_BIQUAD_BATCHLANES
+	float *b0; // coefficients for each stream
+	float *b1;
+	float *b2;
+	float *a1;
+	float *a2;
+	float *xn1L, *xn1R; // history for each stream
+	float *xn2L, *xn2R;
+	float *yn1L, *yn1R;
+	float *yn2L, *yn2R;
+	float *data; // storage for all of the above
+} sf_biquad_batch_st, *sf_biquad_batch;
+
+sf_biquad_batch sf_biquad_batch_new(int count); // returns NULL for error
+void            sf_biquad_batch_free(sf_biquad_batch batch);
+
+// copy the coefficients and history of a state into (or out of) the stream at index
+void sf_biquad_batch_set(sf_biquad_batch batch, int index, const sf_biquad_state_st *state);
+void sf_biquad_batch_get(sf_biquad_batch batch, int index, sf_biquad_state_st *state);
+
+// input and output are arrays of batch->count pointers, each pointing to `size` samples
+void sf_biquad_batch_process(sf_biquad_batch batch, int size, sf_sample_st **input,
+	sf_sample_st **output);
+
+// coefficient caches
+//
+// designing a filter costs a few calls to powf, sinf and cosf; when lots of filters are redesigned
+// over and over (for example, thousands of voices retuned every 64 samples), the same or nearly the
+// same designs keep coming up, so a cache can turn most of the designs into a table lookup:
+//
+//   sf_biquad_cache cache = sf_biquad_cache_new(4096, 12);
+//
+//   for each voice:
+//     sf_biquad_cache_design(cache, &voice->lowpass, SF_BIQUAD_LOWPASS, 48000, cutoff, 1, 0);
+//
+// the size is the number of designs the cache can hold, rounded up to a power of 2; each design
+// maps to a set of SF_BIQUAD_CACHEWAYS entries, and a miss replaces one of them, so the cache
+// should have room for a few times more designs than are in use at once
+//
+// before looking up a design, freq, Q and gain are rounded to `bits` bits of mantissa [1 to 23],
+// so designs that are close enough share an entry; the coefficients are always the exact design of
+// the rounded parameters, and each parameter is off by a relative error of at most 2^-(bits + 1):
+//
+//   bits   freq error            gain error at 12dB
+//    23    none (exact match)    none
+//    16    0.0008% (0.01 cents)  0.0001dB
+//    12    0.012%  (0.21 cents)  0.0015dB
+//     8    0.2%    (3.4 cents)   0.023dB
+//
+// each entry is 40 bytes, and the cache isn't thread safe, so each thread should use its own
+
+// number of entries in each set (must be a power of 2)
+#define SF_BIQUAD_CACHEWAYS      4
+
+typedef struct {
+	int type; // sf_biquad_type, or -1 if the entry is empty
+	int rate;
+	float freq; // rounded design parameters
+	float Q;
+	float gain;
+	float b0; // coefficients
+	float b1;
+	float b2;
+	float a1;
+	float a2;
+} sf_biquad_cache_entry_st;
+
+typedef struct {
+	int size;        // number of entries
+	int bits;        // mantissa bits kept from each design parameter
+	uint64_t hits;   // number of lookups found in the cache
+	uint64_t misses; // number of lookups that had to be designed (also picks the way to replace)
+	sf_biquad_cache_entry_st *entries;
+} sf_biquad_cache_st, *sf_biquad_cache;
+
+sf_biquad_cache sf_biquad_cache_new(int size, int bits); // returns NULL for error
+void            sf_biquad_cache_free(sf_biquad_cache cache);
+
+// same as sf_biquad_design, but looks up the coefficients in the cache first
+void sf_biquad_cache_design(sf_biquad_cache cache, sf_biquad_state_st *state,
+	sf_biquad_type type, int rate, float freq, float Q, float gain);
+
+// same as sf_biquad_retune, but looks up the coefficients in the cache first
+void sf_biquad_cache_retune(sf_biquad_cache cache, sf_biquad_state_st *state,
+	sf_biquad_type type, int rate, float freq, float Q, float gain);
+
+// fixed-point
+//
+// when the sound is 16-bit samples in and 16-bit samples out, converting to floating point and back
+// can be skipped by running the filter on the integers directly:
+//
+//   sf_biquad_state_st lowpass;
+//   sf_lowpass(&lowpass, 44100, 440, 1);
+//
+//   sf_biquad16_st lowpass16;
+//   sf_biquad16(&lowpass16, &lowpass);
+//
+//   for each 128 length sample:
+//     sf_biquad16_process(&lowpass16, 128, input, output);
+//
+// samples are treated as Q1.15 (the sample divided by 32768), and the coefficients are rounded to
+// Q2.29 when they are all within [-4, 4), or Q4.27 when they are within [-16, 16), which covers
+// peaking and shelving filters with up to about +24dB of gain; sf_biquad16 returns false if the
+// coefficients are too large for Q4.27
+//
+// each output is summed in a 64-bit accumulator, so the sum itself never overflows; the output is
+// then rounded down to 16 bits, and saturates to [-32768, 32767] instead of wrapping around, but
+// the history keeps the value from before saturation, so a filter that clips behaves like the
+// floating point one does when its output is clamped by sf_wavsave
+//
+// the rounding error of each output is fed back through a1 and a2 along with the output itself
+// (error feedback), so the rounding isn't amplified by the poles; without it, a low frequency
+// filter turns the rounding into a loud hum, because its poles are so close to the unit circle
+//
+// with the error feedback, the output is within 1 LSB of the exact result (about -90dB of full
+// scale); sf_biquad_process followed by sf_wavsave is about as accurate for most filters, but its
+// error grows for low frequency filters, where it's a few LSB off
+
+typedef struct {
+	int32_t b0; // coefficients, scaled by 2^shift
+	int32_t b1;
+	int32_t b2;
+	int32_t a1;
+	int32_t a2;
+	int shift;  // 29 or 27
+	sf_sample16_st xn1;
+	sf_sample16_st xn2;
+	int32_t yn1L, yn1R; // outputs before saturation
+	int32_t yn2L, yn2R;
+	int64_t en1L, en1R; // rounding error of the outputs, scaled by 2^shift
+	int64_t en2L, en2R;
+} sf_biquad16_st;
+
+// initialize the fixed-point filter from a state created by the functions above, with the history
+// cleared (returns false if the coefficients can't be represented)
+bool sf_biquad16(sf_biquad16_st *st, const sf_biquad_state_st *state);
+
+// process the input sound; the input and output buffers should be the same size
+void sf_biquad16_process(sf_biquad16_st *st, int size, sf_sample16_st *input,
+	sf_sample16_st *output);
+
 #endif // SNDFILTER_BIQUAD__H
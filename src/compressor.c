@@ -6,18 +6,25 @@
 //
 
 #include "compressor.h"
+#include "denormal.h"
+#include "mem.h"
 #include <math.h>
+#include <stdint.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 // core algorithm extracted from Chromium source, DynamicsCompressorKernel.cpp, here:
 //   https://git.io/v1uSK
 //
 // changed a few things though in an attempt to simplify the curves and algorithm, and also included
 // a pregain so that samples can be scaled up then compressed
 
-void sf_defaultcomp(sf_compressor_state_st *state, int rate){
+bool sf_defaultcomp(sf_compressor_state_st *state, int rate){
 	// sane defaults
-	sf_advancecomp(state, rate,
+	return sf_advancecomp(state, rate,
 		  0.000f, // pregain
 		-24.000f, // threshold
 		 30.000f, // knee
@@ -34,10 +41,10 @@ void sf_defaultcomp(sf_compressor_state_st *state, int rate){
 	);
 }
 
-void sf_simplecomp(sf_compressor_state_st *state, int rate, float pregain, float threshold,
+bool sf_simplecomp(sf_compressor_state_st *state, int rate, float pregain, float threshold,
 	float knee, float ratio, float attack, float release){
 	// sane defaults
-	sf_advancecomp(state, rate, pregain, threshold, knee, ratio, attack, release,
+	return sf_advancecomp(state, rate, pregain, threshold, knee, ratio, attack, release,
 		0.006f, // predelay
 		0.090f, // releasezone1
 		0.160f, // releasezone2
@@ -77,19 +84,51 @@ static inline float compcurve(float x, float k, float slope, float linearthresho
 	return db2lin(kneedboffset + slope * (lin2db(x) - threshold - knee));
 }
 
+// allocate and clear the predelay ring for the number of channels
+static bool delayalloc(sf_compressor_state_st *state, int channels){
+	float *delaybuf = NULL;
+	if (state->delaysize > 0){
+		delaybuf = sf_malloc(sizeof(float) * state->delaysize * channels);
+		if (delaybuf == NULL)
+			return false;
+		memset(delaybuf, 0, sizeof(float) * state->delaysize * channels);
+	}
+	if (state->delaybuf)
+		sf_free(state->delaybuf);
+	state->delaybuf = delaybuf;
+	state->channels = channels;
+	state->delaywritepos = 0;
+	state->delayreadpos = (state->delaysize - state->delaysamples) & state->delaymask;
+	return true;
+}
+
 // this is the main initialization function
 // it does a bunch of pre-calculation so that the inner loop of signal processing is fast
-void sf_advancecomp(sf_compressor_state_st *state, int rate, float pregain, float threshold,
+bool sf_advancecomp(sf_compressor_state_st *state, int rate, float pregain, float threshold,
 	float knee, float ratio, float attack, float release, float predelay, float releasezone1,
 	float releasezone2, float releasezone3, float releasezone4, float postgain, float wet){
 
-	// setup the predelay buffer
-	int delaybufsize = rate * predelay;
-	if (delaybufsize < 1)
-		delaybufsize = 1;
-	else if (delaybufsize > SF_COMPRESSOR_MAXDELAY)
-		delaybufsize = SF_COMPRESSOR_MAXDELAY;
-        memset(state->delaybuf, 0, sizeof(sf_sample_st) * delaybufsize);
+	// setup the predelay ring, which is the smallest power of 2 that can hold the delayed samples
+	// plus the current one, so that it can wrap with a mask
+	int delaysamples = (int)(rate * predelay) - 1;
+	if (delaysamples < 0)
+		delaysamples = 0;
+	else if (delaysamples > rate)
+		delaysamples = rate;
+	int delaysize = 0;
+	if (delaysamples > 0){
+		delaysize = 1;
+		while (delaysize <= delaysamples)
+			delaysize <<= 1;
+	}
+	state->delaysamples = delaysamples;
+	state->delaysize    = delaysize;
+	state->delaymask    = delaysize > 0 ? delaysize - 1 : 0;
+	state->delaybuf     = NULL;
+	state->lut          = NULL;
+	state->meter        = NULL;
+	if (!delayalloc(state, 2))
+		return false;
 
 	// useful values
 	float linearpregain = db2lin(pregain);
@@ -167,9 +206,91 @@ void sf_advancecomp(sf_compressor_state_st *state, int rate, float pregain, floa
 	state->detectoravg          = 0.0f;
 	state->compgain             = 1.0f;
 	state->maxcompdiffdb        = -1.0f;
-	state->delaybufsize         = delaybufsize;
-	state->delaywritepos        = 0;
-	state->delayreadpos         = delaybufsize > 1 ? 1 : 0;
+	state->scaleddesiredgain    = 0.0f;
+	state->enveloperate         = 1.0f;
+	state->chunkpos             = 0;
+	state->spu                  = SF_COMPRESSOR_SPU;
+	state->decimate             = 1;
+	state->decimatepos          = 0;
+	state->decimatepeak         = 0.0f;
+	return true;
+}
+
+bool sf_compressor_controlrate(sf_compressor_state_st *state, int spu, int decimate){
+	if (spu < 1 || spu > SF_COMPRESSOR_MAXSPU || decimate < 1 || spu % decimate != 0)
+		return false;
+	state->spu          = spu;
+	state->decimate     = decimate;
+	state->chunkpos     = 0;
+	state->decimatepos  = 0;
+	state->decimatepeak = 0.0f;
+	return true;
+}
+
+bool sf_compressor_channels(sf_compressor_state_st *state, int channels){
+	if (channels < 1 || channels > SF_SND_MAXCHANNELS)
+		return false;
+	return delayalloc(state, channels);
+}
+
+void sf_compressor_free(sf_compressor_state_st *state){
+	if (state->delaybuf)
+		sf_free(state->delaybuf);
+	if (state->lut)
+		sf_free(state->lut);
+	state->delaybuf = NULL;
+	state->lut = NULL;
+}
+
+void sf_compressor_meter(sf_compressor_state_st *state, sf_compressor_meter_st *meter){
+#ifdef SF_COMPRESSOR_NOMETER
+	// metering is compiled out, so the meter would never be written
+	if (meter)
+		memset(meter, 0, sizeof(sf_compressor_meter_st));
+	state->meter = NULL;
+#else
+	state->meter = meter;
+#endif
+}
+
+// fill the lookup table with the attenuation and the release rate of the detector, at input levels
+// spaced SF_COMPRESSOR_LUTSTEPS per octave; these are the same calculations as the exact path in
+// compressor_process, done once per table entry instead of once per sample
+static void lutbuild(sf_compressor_state_st *state, float *lut){
+	for (int i = 0; i < SF_COMPRESSOR_LUTSIZE; i++){
+		float x = ldexpf(1.0f + (float)(i % SF_COMPRESSOR_LUTSTEPS) / SF_COMPRESSOR_LUTSTEPS,
+			i / SF_COMPRESSOR_LUTSTEPS + SF_COMPRESSOR_LUTMINEXP);
+		float attenuation;
+		if (x < 0.0001f)
+			attenuation = 1.0f;
+		else{
+			float inputcomp = compcurve(x, state->k, state->slope, state->linearthreshold,
+				state->linearthresholdknee, state->threshold, state->knee, state->kneedboffset);
+			attenuation = inputcomp / x;
+		}
+		float attenuationdb = -lin2db(attenuation);
+		if (attenuationdb < 2.0f)
+			attenuationdb = 2.0f;
+		lut[i * 2 + 0] = attenuation;
+		lut[i * 2 + 1] = db2lin(attenuationdb * state->satreleasesamplesinv) - 1.0f;
+	}
+}
+
+bool sf_compressor_lut(sf_compressor_state_st *state, bool enable){
+	if (!enable){
+		if (state->lut)
+			sf_free(state->lut);
+		state->lut = NULL;
+		return true;
+	}
+	if (state->lut)
+		return true;
+	float *lut = sf_malloc(sizeof(float) * 2 * SF_COMPRESSOR_LUTSIZE);
+	if (lut == NULL)
+		return false;
+	lutbuild(state, lut);
+	state->lut = lut;
+	return true;
 }
 
 // for more information on the adaptive release curve, check out adaptive-release-curve.html demo +
@@ -184,8 +305,9 @@ static inline float clampf(float v, float min, float max){
 	return v < min ? min : (v > max ? max : v);
 }
 
+// clears the sign bit, so -0.0 becomes 0.0 (lutlookup indexes the table with the float's bits)
 static inline float absf(float v){
-	return v < 0.0f ? -v : v;
+	return fabsf(v);
 }
 
 static inline float fixf(float v, float def){
@@ -195,12 +317,174 @@ static inline float fixf(float v, float def){
 	return v;
 }
 
-void sf_compressor_process(sf_compressor_state_st *state, int size, sf_sample_st *input,
-	sf_sample_st *output){
+static inline uint32_t float_bits(float f){
+	uint32_t u;
+	memcpy(&u, &f, sizeof(u));
+	return u;
+}
+
+static inline float bits_float(uint32_t u){
+	float f;
+	memcpy(&f, &u, sizeof(f));
+	return f;
+}
+
+// approximations used by the lookup table mode (the errors are measured in float arithmetic)
+
+// sin(x * pi / 2) for x in [0, 1], least squares fit, error below 2e-7
+static inline float fastsin90(float x){
+	float x2 = x * x;
+	return x * (1.5707963f + x2 * (-0.64596344f + x2 * (0.079688738f + x2 * (-0.0046725482f +
+		x2 * 0.00015095614f))));
+}
+
+// asin(x) * 2 / pi for x in [0, 1], Abramowitz and Stegun 4.4.46 (scaled), error below 2e-7
+static inline float fastasin90(float x){
+	return 1.0f - sqrtf(1.0f - x) * (0.99999999f + x * (-0.13661784f + x * (0.056645783f +
+		x * (-0.031941954f + x * (0.019666382f + x * (-0.010878639f + x * (0.0042463112f +
+		x * -0.00080372680f)))))));
+}
+
+// lin2db for positive values, using the float exponent and a fit of log2 on the mantissa, error
+// below 0.0002dB; zero becomes a very small value (about -770dB) instead of -infinity
+static inline float fastlin2db(float lin){
+	uint32_t u = float_bits(lin);
+	float e = (float)((int)(u >> 23) - 127);
+	float t = bits_float((u & 0x007FFFFF) | 0x3F800000) - 1.0f;
+	return 6.0205999f * (e + t * (1.4418799f + t * (-0.70886522f + t * (0.41524556f +
+		t * (-0.19351653f + t * 0.045268293f)))));
+}
+
+// look up the attenuation and the release rate for an input level below 2^SF_COMPRESSOR_LUTMAXEXP,
+// with linear interpolation between the table entries; levels below the table use the first entry
+static inline void lutlookup(const float *lut, float x, float *attenuation, float *releaserate){
+	const int shift = 23 - SF_COMPRESSOR_LUTBITS;
+	const uint32_t base = (uint32_t)(127 + SF_COMPRESSOR_LUTMINEXP) << 23;
+	uint32_t u = float_bits(x);
+	int i = 0;
+	float frac = 0.0f;
+	if (u >= base){
+		i = (int)((u - base) >> shift);
+		frac = (float)(u & ((1u << shift) - 1)) * (1.0f / (float)(1u << shift));
+	}
+	const float *e = &lut[i * 2];
+	*attenuation = e[0] + (e[2] - e[0]) * frac;
+	*releaserate = e[1] + (e[3] - e[1]) * frac;
+}
+
+#if defined(__SSE2__)
+// four lane versions of the approximations; sin90 and log2 perform the same operations as fastsin90
+// and fastlin2db (so they give identical results), and exp2 is a fit of 2^x on [0, 1) with relative
+// error below 2e-7
+static inline __m128 v_select(__m128 mask, __m128 a, __m128 b){
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+static inline __m128 v_log2(__m128 x){
+	__m128i u = _mm_castps_si128(x);
+	__m128 e = _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(u, 23), _mm_set1_epi32(127)));
+	__m128 t = _mm_sub_ps(_mm_castsi128_ps(_mm_or_si128(
+		_mm_and_si128(u, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000))),
+		_mm_set1_ps(1.0f));
+	__m128 p = _mm_set1_ps(0.045268293f);
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(-0.19351653f));
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(0.41524556f));
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(-0.70886522f));
+	p = _mm_add_ps(_mm_mul_ps(p, t), _mm_set1_ps(1.4418799f));
+	return _mm_add_ps(e, _mm_mul_ps(p, t));
+}
+
+static inline __m128 v_exp2(__m128 x){
+	x = _mm_min_ps(_mm_max_ps(x, _mm_set1_ps(-126.0f)), _mm_set1_ps(126.0f));
+	__m128i i = _mm_cvttps_epi32(x);
+	__m128 fi = _mm_cvtepi32_ps(i);
+	// truncation rounds negative values up, so correct it to floor
+	__m128 up = _mm_cmpgt_ps(fi, x);
+	i = _mm_add_epi32(i, _mm_castps_si128(up)); // subtracts 1 where up is all ones
+	fi = _mm_sub_ps(fi, _mm_and_ps(up, _mm_set1_ps(1.0f)));
+	__m128 f = _mm_sub_ps(x, fi);
+	__m128 p = _mm_set1_ps(0.0018854026f);
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.0089729023f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.055836595f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.24015245f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(0.69315254f));
+	p = _mm_add_ps(_mm_mul_ps(p, f), _mm_set1_ps(1.0f));
+	__m128i scale = _mm_slli_epi32(_mm_add_epi32(i, _mm_set1_epi32(127)), 23);
+	return _mm_mul_ps(p, _mm_castsi128_ps(scale));
+}
+
+static inline __m128 v_sin90(__m128 x){
+	__m128 x2 = _mm_mul_ps(x, x);
+	__m128 p = _mm_set1_ps(0.00015095614f);
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-0.0046725482f));
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(0.079688738f));
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(-0.64596344f));
+	p = _mm_add_ps(_mm_mul_ps(p, x2), _mm_set1_ps(1.5707963f));
+	return _mm_mul_ps(p, x);
+}
+#endif
+
+// larger of two values, or b if either is NaN
+static inline float maxf(float a, float b){
+#if defined(__SSE2__)
+	return _mm_cvtss_f32(_mm_max_ss(_mm_set_ss(a), _mm_set_ss(b)));
+#else
+	return a > b ? a : b;
+#endif
+}
+
+// calculate the envelope for the next sub-chunk, based on the detector and the current gain
+static inline void envelope(float *detectoravg, float compgain, float *maxcompdiffdb, float a,
+	float b, float c, float d, float attacksamplesinv, bool fast, float *scaleddesiredgain,
+	float *enveloperate){
+	float ang90inv = 2.0f / (float)M_PI;
+	float spacingdb = SF_COMPRESSOR_SPACINGDB;
+
+	*detectoravg = fixf(*detectoravg, 1.0f);
+	float desiredgain = *detectoravg;
+	if (fast)
+		*scaleddesiredgain = fastasin90(desiredgain);
+	else
+		*scaleddesiredgain = asinf(desiredgain) * ang90inv;
+	float compdiffdb = lin2db(compgain / *scaleddesiredgain);
+
+	// calculate envelope rate based on whether we're attacking or releasing
+	if (compdiffdb < 0.0f){ // compgain < scaleddesiredgain, so we're releasing
+		compdiffdb = fixf(compdiffdb, -1.0f);
+		*maxcompdiffdb = -1; // reset for a future attack mode
+		// apply the adaptive release curve
+		// scale compdiffdb between 0-3
+		float x = (clampf(compdiffdb, -12.0f, 0.0f) + 12.0f) * 0.25f;
+		float releasesamples = adaptivereleasecurve(x, a, b, c, d);
+		*enveloperate = db2lin(spacingdb / releasesamples);
+	}
+	else{ // compresorgain > scaleddesiredgain, so we're attacking
+		compdiffdb = fixf(compdiffdb, 1.0f);
+		if (*maxcompdiffdb == -1 || *maxcompdiffdb < compdiffdb)
+			*maxcompdiffdb = compdiffdb;
+		float attenuate = *maxcompdiffdb;
+		if (attenuate < 0.5f)
+			attenuate = 0.5f;
+		*enveloperate = 1.0f - powf(0.25f / attenuate, attacksamplesinv);
+	}
+}
+
+// the samples are interleaved with `channels` values each; every channel gets the same gain, based
+// on the loudest channel of the key (which is the input itself when key is NULL)
+//
+// when gains isn't NULL, only the detector runs, and the gain of each sample (including the
+// pregain) is written to gains instead of being applied (input and output are ignored, and the
+// predelay isn't used)
+//
+// this is inlined into each public function, so the checks for key and gains are resolved at
+// compile time for the usual case of compressing the input by itself
+static inline void compressor_process(sf_compressor_state_st *state, int channels, int size,
+	const float *input, float *output, int keychannels, const float *key, float *gains){
+	sf_denormal_st dn;
+	sf_denormal_begin(&dn);
 
 	// pull out the state into local variables
 	float metergain            = state->metergain;
-	float meterrelease         = state->meterrelease;
 	float threshold            = state->threshold;
 	float knee                 = state->knee;
 	float linearpregain        = state->linearpregain;
@@ -221,114 +505,779 @@ void sf_compressor_process(sf_compressor_state_st *state, int size, sf_sample_st
 	float detectoravg          = state->detectoravg;
 	float compgain             = state->compgain;
 	float maxcompdiffdb        = state->maxcompdiffdb;
-	int delaybufsize           = state->delaybufsize;
+	float scaleddesiredgain    = state->scaleddesiredgain;
+	float enveloperate         = state->enveloperate;
+	int chunkpos               = state->chunkpos;
+	int decimate               = state->decimate;
+	int decimatepos            = state->decimatepos;
+	float decimatepeak         = state->decimatepeak;
+	int delaymask              = state->delaymask;
 	int delaywritepos          = state->delaywritepos;
 	int delayreadpos           = state->delayreadpos;
-	sf_sample_st *delaybuf     = state->delaybuf;
+	float *delaybuf            = state->delaybuf;
+	float *lut                 = state->lut;
+	float lutmax               = ldexpf(1.0f, SF_COMPRESSOR_LUTMAXEXP);
+
+#ifndef SF_COMPRESSOR_NOMETER
+	float meterrelease = state->meterrelease;
+	sf_compressor_meter_st *meter = state->meter;
 
-	int samplesperchunk = SF_COMPRESSOR_SPU;
-	int chunks = size / samplesperchunk;
+	// block meter totals
+	float meterpeak = 0.0f;
+	float metermin = 1.0f;
+	float metermax = 0.0f;
+	double metersumsq = 0.0;
+	double metersum = 0.0;
+#endif
+
+	// without a predelay, a single frame is written and then read back in place
+	float frame[SF_SND_MAXCHANNELS];
+	if (delaybuf == NULL)
+		delaybuf = frame;
+
+	int samplesperchunk = state->spu;
 	float ang90 = (float)M_PI * 0.5f;
-	float ang90inv = 2.0f / (float)M_PI;
 	int samplepos = 0;
-	float spacingdb = SF_COMPRESSOR_SPACINGDB;
 
-	for (int ch = 0; ch < chunks; ch++){
-		detectoravg = fixf(detectoravg, 1.0f);
-		float desiredgain = detectoravg;
-		float scaleddesiredgain = asinf(desiredgain) * ang90inv;
-		float compdiffdb = lin2db(compgain / scaleddesiredgain);
-
-		// calculate envelope rate based on whether we're attacking or releasing
-		float enveloperate;
-		if (compdiffdb < 0.0f){ // compgain < scaleddesiredgain, so we're releasing
-			compdiffdb = fixf(compdiffdb, -1.0f);
-			maxcompdiffdb = -1; // reset for a future attack mode
-			// apply the adaptive release curve
-			// scale compdiffdb between 0-3
-			float x = (clampf(compdiffdb, -12.0f, 0.0f) + 12.0f) * 0.25f;
-			float releasesamples = adaptivereleasecurve(x, a, b, c, d);
-			enveloperate = db2lin(spacingdb / releasesamples);
+	// the envelope is updated at the start of every sub-chunk; a sub-chunk can be split across
+	// calls, in which case the envelope computed in the previous call is carried over in the state
+	while (samplepos < size){
+		if (chunkpos == 0){
+			envelope(&detectoravg, compgain, &maxcompdiffdb, a, b, c, d, attacksamplesinv,
+				lut != NULL, &scaleddesiredgain, &enveloperate);
 		}
-		else{ // compresorgain > scaleddesiredgain, so we're attacking
-			compdiffdb = fixf(compdiffdb, 1.0f);
-			if (maxcompdiffdb == -1 || maxcompdiffdb < compdiffdb)
-				maxcompdiffdb = compdiffdb;
-			float attenuate = maxcompdiffdb;
-			if (attenuate < 0.5f)
-				attenuate = 0.5f;
-			enveloperate = 1.0f - powf(0.25f / attenuate, attacksamplesinv);
+
+		// process as much of the sub-chunk as the input allows
+		int len = samplesperchunk - chunkpos;
+		if (len > size - samplepos)
+			len = size - samplepos;
+		chunkpos = (chunkpos + len) % samplesperchunk;
+
+		// the sub-chunk is processed in blocks, each in three phases, so that the heavy math isn't
+		// stuck behind the serial detector and envelope:
+		//   1. the peak of the key for each sample, and the compression curve and release rate for
+		//      each sample the detector runs on, none of which depend on the previous sample
+		//   2. the detector and compressor gain recurrences, which are only a few multiplies each
+		//   3. the gain law, metering, and the predelay, for each sample
+		for (int blockend = samplepos + len; samplepos < blockend; ){
+			int blocklen = blockend - samplepos;
+			if (blocklen > SF_COMPRESSOR_KERNELBLOCK)
+				blocklen = SF_COMPRESSOR_KERNELBLOCK;
+			bool detects[SF_COMPRESSOR_KERNELBLOCK];
+			float attenuations[SF_COMPRESSOR_KERNELBLOCK];
+			float releaserates[SF_COMPRESSOR_KERNELBLOCK];
+			float compgains[SF_COMPRESSOR_KERNELBLOCK];
+			float inputmaxes[SF_COMPRESSOR_KERNELBLOCK];
+#ifndef SF_COMPRESSOR_NOMETER
+			float inputsqs[SF_COMPRESSOR_KERNELBLOCK];
+#endif
+
+			// phase 1, the loudest channel of the key
+			int kchannels = key ? keychannels : channels;
+			const float *kin = key ? &key[samplepos * keychannels] : &input[samplepos * channels];
+			int vn = 0;
+#if defined(__SSE2__)
+			if (kchannels == 2){
+				// four stereo samples at a time
+				__m128 pregain = _mm_set1_ps(linearpregain);
+				__m128 sign = _mm_set1_ps(-0.0f);
+				for (; vn + 4 <= blocklen; vn += 4){
+					__m128 s01 = _mm_mul_ps(_mm_loadu_ps(&kin[vn * 2 + 0]), pregain); // L0 R0 L1 R1
+					__m128 s23 = _mm_mul_ps(_mm_loadu_ps(&kin[vn * 2 + 4]), pregain); // L2 R2 L3 R3
+					__m128 L = _mm_shuffle_ps(s01, s23, _MM_SHUFFLE(2, 0, 2, 0));
+					__m128 R = _mm_shuffle_ps(s01, s23, _MM_SHUFFLE(3, 1, 3, 1));
+#ifndef SF_COMPRESSOR_NOMETER
+					_mm_storeu_ps(&inputsqs[vn], _mm_add_ps(_mm_mul_ps(L, L), _mm_mul_ps(R, R)));
+#endif
+					_mm_storeu_ps(&inputmaxes[vn],
+						_mm_max_ps(_mm_andnot_ps(sign, L), _mm_andnot_ps(sign, R)));
+				}
+			}
+#endif
+			for (int n = vn; n < blocklen; n++){
+				float inputmax = 0.0f;
+#ifndef SF_COMPRESSOR_NOMETER
+				float inputsq = 0.0f;
+#endif
+				for (int ch = 0; ch < kchannels; ch++){
+					float v = kin[n * kchannels + ch] * linearpregain;
+#ifndef SF_COMPRESSOR_NOMETER
+					inputsq += v * v;
+#endif
+					v = absf(v);
+					inputmax = ch == 0 ? v : maxf(inputmax, v);
+				}
+				inputmaxes[n] = inputmax;
+#ifndef SF_COMPRESSOR_NOMETER
+				inputsqs[n] = inputsq;
+#endif
+			}
+
+			// with a decimated detector, the detector only runs at the end of every group of
+			// `decimate` samples, on the peak of the group
+			for (int n = 0; n < blocklen; n++){
+				float inputmax = inputmaxes[n];
+				detects[n] = true;
+				attenuations[n] = inputmax;
+				if (decimate > 1){
+					if (decimatepos == 0 || !(decimatepeak > inputmax))
+						decimatepeak = inputmax;
+					decimatepos++;
+					if (decimatepos < decimate)
+						detects[n] = false;
+					else{
+						attenuations[n] = decimatepeak;
+						decimatepos = 0;
+					}
+				}
+			}
+
+			// phase 1, the compression curve; the release rate is calculated for every sample,
+			// and only used if the detector is releasing
+			for (int n = 0; n < blocklen; n++){
+				if (!detects[n])
+					continue;
+				float detectormax = attenuations[n];
+				float attenuation;
+				float rate;
+				if (lut && detectormax < lutmax)
+					lutlookup(lut, detectormax, &attenuation, &rate);
+				else{
+					if (detectormax < 0.0001f)
+						attenuation = 1.0f;
+					else{
+						float inputcomp = compcurve(detectormax, k, slope, linearthreshold,
+							linearthresholdknee, threshold, knee, kneedboffset);
+						attenuation = inputcomp / detectormax;
+					}
+
+					float attenuationdb = -lin2db(attenuation);
+					if (attenuationdb < 2.0f)
+						attenuationdb = 2.0f;
+					float dbpersample = attenuationdb * satreleasesamplesinv;
+					rate = db2lin(dbpersample) - 1.0f;
+				}
+
+				// the rate is per sample, so a step covering the whole group closes the same
+				// distance that `decimate` steps would
+				if (decimate > 1 && rate < 1.0f)
+					rate = 1.0f - powf(1.0f - rate, (float)decimate);
+
+				attenuations[n] = attenuation;
+				releaserates[n] = rate;
+			}
+
+			// phase 2
+			for (int n = 0; n < blocklen; n++){
+				if (detects[n]){
+					float attenuation = attenuations[n];
+					float rate = attenuation > detectoravg ? releaserates[n] : 1.0f; // if releasing
+					detectoravg += (attenuation - detectoravg) * rate;
+					if (detectoravg > 1.0f)
+						detectoravg = 1.0f;
+					detectoravg = fixf(detectoravg, 1.0f);
+				}
+
+				if (enveloperate < 1) // attack, reduce gain
+					compgain += (scaleddesiredgain - compgain) * enveloperate;
+				else{ // release, increase gain
+					compgain *= enveloperate;
+					if (compgain > 1.0f)
+						compgain = 1.0f;
+				}
+				compgains[n] = compgain;
+			}
+
+			// phase 3, the gain law (and the gain in dB for metergain), which is vectorized for
+			// the lookup table mode
+			float premixgains[SF_COMPRESSOR_KERNELBLOCK];
+#ifndef SF_COMPRESSOR_NOMETER
+			float premixgaindbs[SF_COMPRESSOR_KERNELBLOCK];
+			bool meterdb = meter == NULL;
+#else
+			float *premixgaindbs = NULL;
+			bool meterdb = false;
+#endif
+			vn = 0;
+#if defined(__SSE2__)
+			if (lut){
+				for (; vn + 4 <= blocklen; vn += 4){
+					__m128 premixgain = v_sin90(_mm_loadu_ps(&compgains[vn]));
+					_mm_storeu_ps(&premixgains[vn], premixgain);
+					if (meterdb){
+						_mm_storeu_ps(&premixgaindbs[vn],
+							_mm_mul_ps(v_log2(premixgain), _mm_set1_ps(6.0205999f)));
+					}
+				}
+			}
+#endif
+			for (int n = vn; n < blocklen; n++){
+				float premixgain = lut ? fastsin90(compgains[n]) : sinf(ang90 * compgains[n]);
+				premixgains[n] = premixgain;
+				if (meterdb)
+					premixgaindbs[n] = lut ? fastlin2db(premixgain) : lin2db(premixgain);
+			}
+
+			// phase 3, metering and the predelay
+			for (int n = 0; n < blocklen; n++, samplepos++,
+				delayreadpos = (delayreadpos + 1) & delaymask,
+				delaywritepos = (delaywritepos + 1) & delaymask){
+
+				// the final gain value!
+				float premixgain = premixgains[n];
+				float gain = dry + wet * mastergain * premixgain;
+
+#ifndef SF_COMPRESSOR_NOMETER
+				// calculate metering (not used in core algo, but used to output a meter if desired)
+				if (meter){
+					// block meter, converted to dB after the loop
+					if (inputmaxes[n] > meterpeak)
+						meterpeak = inputmaxes[n];
+					if (premixgain < metermin)
+						metermin = premixgain;
+					if (premixgain > metermax)
+						metermax = premixgain;
+					metersumsq += inputsqs[n];
+					metersum += premixgain;
+				}
+				else{
+					float premixgaindb = premixgaindbs[n];
+					if (premixgaindb < metergain)
+						metergain = premixgaindb; // spike immediately
+					else
+						metergain += (premixgaindb - metergain) * meterrelease; // fall slowly
+				}
+#endif
+
+				// store the input in the predelay, and apply the gain to the delayed input
+				if (gains)
+					gains[samplepos] = gain * linearpregain;
+				else{
+					const float *in = &input[samplepos * channels];
+					float *delayin = &delaybuf[delaywritepos * channels];
+					for (int ch = 0; ch < channels; ch++)
+						delayin[ch] = in[ch] * linearpregain;
+					float *out = &output[samplepos * channels];
+					float *delayout = &delaybuf[delayreadpos * channels];
+					for (int ch = 0; ch < channels; ch++)
+						out[ch] = delayout[ch] * gain;
+				}
+			}
 		}
+	}
+
+#ifndef SF_COMPRESSOR_NOMETER
+	if (meter && size > 0){
+		meter->inputpeak = lin2db(meterpeak / linearpregain);
+		meter->inputrms  = lin2db(sqrtf((float)(metersumsq /
+			((double)size * (key ? keychannels : channels)))) / linearpregain);
+		meter->gainmin   = lin2db(metermin);
+		meter->gainmax   = lin2db(metermax);
+		meter->gainavg   = lin2db((float)(metersum / size));
+	}
+#endif
 
-		// process the chunk
-		for (int chi = 0; chi < samplesperchunk; chi++, samplepos++,
-			delayreadpos = (delayreadpos + 1) % delaybufsize,
-			delaywritepos = (delaywritepos + 1) % delaybufsize){
+	state->metergain         = metergain;
+	state->detectoravg       = detectoravg;
+	state->compgain          = compgain;
+	state->maxcompdiffdb     = maxcompdiffdb;
+	state->scaleddesiredgain = scaleddesiredgain;
+	state->enveloperate      = enveloperate;
+	state->chunkpos          = chunkpos;
+	state->decimatepos       = decimatepos;
+	state->decimatepeak      = decimatepeak;
+	if (gains == NULL){
+		state->delaywritepos = delaywritepos;
+		state->delayreadpos  = delayreadpos;
+	}
+	sf_denormal_end(&dn);
+}
 
-			float inputL = input[samplepos].L * linearpregain;
-			float inputR = input[samplepos].R * linearpregain;
-			delaybuf[delaywritepos] = (sf_sample_st){ .L = inputL, .R = inputR };
+bool sf_compressor_process(sf_compressor_state_st *state, int size, sf_sample_st *input,
+	sf_sample_st *output){
+	if (state->channels != 2)
+		return false;
+	compressor_process(state, 2, size, (float *)input, (float *)output, 0, NULL, NULL);
+	return true;
+}
 
-			inputL = absf(inputL);
-			inputR = absf(inputR);
-			float inputmax = inputL > inputR ? inputL : inputR;
+bool sf_compressor_processn(sf_compressor_state_st *state, int channels, int size, float *input,
+	float *output){
+	if (channels != state->channels)
+		return false;
+	compressor_process(state, channels, size, input, output, 0, NULL, NULL);
+	return true;
+}
 
-			float attenuation;
-			if (inputmax < 0.0001f)
-				attenuation = 1.0f;
-			else{
-				float inputcomp = compcurve(inputmax, k, slope, linearthreshold,
-					linearthresholdknee, threshold, knee, kneedboffset);
-				attenuation = inputcomp / inputmax;
+bool sf_compressor_sidechain(sf_compressor_state_st *state, int size, sf_sample_st *input,
+	sf_sample_st *key, sf_sample_st *output){
+	if (state->channels != 2)
+		return false;
+	compressor_process(state, 2, size, (float *)input, (float *)output, 2, (float *)key, NULL);
+	return true;
+}
+
+bool sf_compressor_sidechainn(sf_compressor_state_st *state, int channels, int size,
+	float *input, int keychannels, float *key, float *output){
+	if (channels != state->channels || keychannels < 1 || keychannels > SF_SND_MAXCHANNELS)
+		return false;
+	compressor_process(state, channels, size, input, output, keychannels, key, NULL);
+	return true;
+}
+
+bool sf_compressor_gain(sf_compressor_state_st *state, int keychannels, int size, float *key,
+	float *gains){
+	if (keychannels < 1 || keychannels > SF_SND_MAXCHANNELS)
+		return false;
+	compressor_process(state, 0, size, NULL, NULL, keychannels, key, gains);
+	return true;
+}
+
+void sf_compressor_applygain(int channels, int size, const float *gains, float *input,
+	float *output){
+	for (int n = 0; n < size; n++){
+		float g = gains[n];
+		for (int ch = 0; ch < channels; ch++)
+			output[n * channels + ch] = input[n * channels + ch] * g;
+	}
+}
+
+//
+// batches
+//
+
+sf_compressor_batch sf_compressor_batch_new(int count, int maxdelay){
+	if (count < 1 || maxdelay < 0)
+		return NULL;
+	int delaysize = 1;
+	while (delaysize <= maxdelay)
+		delaysize <<= 1;
+	int lanes = ((count + SF_COMPRESSOR_BATCHLANES - 1) / SF_COMPRESSOR_BATCHLANES) *
+		SF_COMPRESSOR_BATCHLANES;
+
+	sf_compressor_batch batch = sf_malloc(sizeof(sf_compressor_batch_st));
+	if (batch == NULL)
+		return NULL;
+	batch->delaysamples = sf_malloc(sizeof(int) * lanes);
+	// 20 values for each stream, then the predelay rings
+	size_t total = (size_t)20 * lanes + (size_t)2 * lanes * delaysize;
+	batch->data = sf_malloc(sizeof(float) * total);
+	if (batch->delaysamples == NULL || batch->data == NULL){
+		if (batch->delaysamples)
+			sf_free(batch->delaysamples);
+		if (batch->data)
+			sf_free(batch->data);
+		sf_free(batch);
+		return NULL;
+	}
+	memset(batch->data, 0, sizeof(float) * total);
+
+	batch->count                = count;
+	batch->lanes                = lanes;
+	batch->delaysize            = delaysize;
+	batch->delaywritepos        = 0;
+	batch->chunkpos             = 0;
+	batch->linearpregain        = &batch->data[ 0 * lanes];
+	batch->linearthreshold      = &batch->data[ 1 * lanes];
+	batch->linearthresholdknee  = &batch->data[ 2 * lanes];
+	batch->k                    = &batch->data[ 3 * lanes];
+	batch->slope                = &batch->data[ 4 * lanes];
+	batch->curveoffset          = &batch->data[ 5 * lanes];
+	batch->curvethreshold       = &batch->data[ 6 * lanes];
+	batch->satreleasesamplesinv = &batch->data[ 7 * lanes];
+	batch->attacksamplesinv     = &batch->data[ 8 * lanes];
+	batch->wetgain              = &batch->data[ 9 * lanes];
+	batch->dry                  = &batch->data[10 * lanes];
+	batch->a                    = &batch->data[11 * lanes];
+	batch->b                    = &batch->data[12 * lanes];
+	batch->c                    = &batch->data[13 * lanes];
+	batch->d                    = &batch->data[14 * lanes];
+	batch->detectoravg          = &batch->data[15 * lanes];
+	batch->compgain             = &batch->data[16 * lanes];
+	batch->maxcompdiffdb        = &batch->data[17 * lanes];
+	batch->scaleddesiredgain    = &batch->data[18 * lanes];
+	batch->enveloperate         = &batch->data[19 * lanes];
+	batch->delayL               = &batch->data[20 * lanes];
+	batch->delayR               = &batch->delayL[(size_t)lanes * delaysize];
+
+	// every stream starts out with a threshold that can't be reached, and the gain at 1, so it
+	// doesn't change the sound
+	for (int i = 0; i < lanes; i++){
+		batch->linearpregain[i]    = 1.0f;
+		batch->linearthreshold[i]  = 1e30f;
+		batch->k[i]                = 1.0f;
+		batch->slope[i]            = 1.0f;
+		batch->attacksamplesinv[i] = 1.0f;
+		batch->wetgain[i]          = 1.0f;
+		batch->d[i]                = 1.0f;
+		batch->detectoravg[i]      = 1.0f;
+		batch->compgain[i]         = 1.0f;
+		batch->maxcompdiffdb[i]    = -1.0f;
+		batch->scaleddesiredgain[i] = 1.0f;
+		batch->enveloperate[i]     = 1.0f;
+		batch->delaysamples[i]     = 0;
+	}
+	return batch;
+}
+
+void sf_compressor_batch_free(sf_compressor_batch batch){
+	sf_free(batch->delaysamples);
+	sf_free(batch->data);
+	sf_free(batch);
+}
+
+// location of a stream's sample in the predelay rings
+static inline size_t batch_delayindex(sf_compressor_batch batch, int index, int pos){
+	int group = index / SF_COMPRESSOR_BATCHLANES;
+	return ((size_t)group * batch->delaysize + (pos & (batch->delaysize - 1))) *
+		SF_COMPRESSOR_BATCHLANES + index % SF_COMPRESSOR_BATCHLANES;
+}
+
+bool sf_compressor_batch_set(sf_compressor_batch batch, int index,
+	const sf_compressor_state_st *state){
+	if (state->channels != 2 || state->delaysamples >= batch->delaysize ||
+		state->spu != SF_COMPRESSOR_SPU || state->decimate != 1)
+		return false;
+	bool hasknee = state->knee > 0.0f;
+	batch->linearpregain       [index] = state->linearpregain;
+	batch->linearthreshold     [index] = state->linearthreshold;
+	batch->linearthresholdknee [index] = hasknee ? state->linearthresholdknee : 0.0f;
+	batch->k                   [index] = state->k;
+	batch->slope               [index] = state->slope;
+	batch->curveoffset         [index] = hasknee ? state->kneedboffset : state->threshold;
+	batch->curvethreshold      [index] = state->threshold + (hasknee ? state->knee : 0.0f);
+	batch->satreleasesamplesinv[index] = state->satreleasesamplesinv;
+	batch->attacksamplesinv    [index] = state->attacksamplesinv;
+	batch->wetgain             [index] = state->wet * state->mastergain;
+	batch->dry                 [index] = state->dry;
+	batch->a                   [index] = state->a;
+	batch->b                   [index] = state->b;
+	batch->c                   [index] = state->c;
+	batch->d                   [index] = state->d;
+	batch->delaysamples        [index] = state->delaysamples;
+	batch->detectoravg         [index] = state->detectoravg;
+	batch->compgain            [index] = state->compgain;
+	batch->maxcompdiffdb       [index] = state->maxcompdiffdb;
+	batch->scaleddesiredgain   [index] = state->scaleddesiredgain;
+	batch->enveloperate        [index] = state->enveloperate;
+
+	// copy the samples waiting in the predelay
+	for (int age = 1; age <= state->delaysamples; age++){
+		int from = ((state->delaywritepos - age) & state->delaymask) * 2;
+		size_t to = batch_delayindex(batch, index, batch->delaywritepos - age);
+		batch->delayL[to] = state->delaybuf[from + 0];
+		batch->delayR[to] = state->delaybuf[from + 1];
+	}
+	return true;
+}
+
+bool sf_compressor_batch_get(sf_compressor_batch batch, int index, sf_compressor_state_st *state){
+	if (state->channels != 2 || state->delaysamples != batch->delaysamples[index])
+		return false;
+	state->detectoravg       = batch->detectoravg      [index];
+	state->compgain          = batch->compgain         [index];
+	state->maxcompdiffdb     = batch->maxcompdiffdb    [index];
+	state->scaleddesiredgain = batch->scaleddesiredgain[index];
+	state->enveloperate      = batch->enveloperate     [index];
+	state->chunkpos          = batch->chunkpos;
+	for (int age = 1; age <= state->delaysamples; age++){
+		size_t from = batch_delayindex(batch, index, batch->delaywritepos - age);
+		int to = ((state->delaywritepos - age) & state->delaymask) * 2;
+		state->delaybuf[to + 0] = batch->delayL[from];
+		state->delaybuf[to + 1] = batch->delayR[from];
+	}
+	return true;
+}
+
+// transpose a block of samples between each stream's buffer and the batch layout, where every row
+// is one sample of each stream
+#if defined(__SSE2__)
+static inline void batch_transposein(int len, sf_sample_st **in,
+	float xL[SF_COMPRESSOR_SPU][SF_COMPRESSOR_BATCHLANES],
+	float xR[SF_COMPRESSOR_SPU][SF_COMPRESSOR_BATCHLANES]){
+	int n = 0;
+	for (; n + 4 <= len; n += 4){
+		for (int i = 0; i < SF_COMPRESSOR_BATCHLANES; i += 4){
+			__m128 L[4], R[4];
+			for (int k = 0; k < 4; k++){
+				__m128 a = _mm_loadu_ps(&in[i + k][n    ].L); // L0 R0 L1 R1
+				__m128 b = _mm_loadu_ps(&in[i + k][n + 2].L); // L2 R2 L3 R3
+				L[k] = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));
+				R[k] = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+			}
+			_MM_TRANSPOSE4_PS(L[0], L[1], L[2], L[3]);
+			_MM_TRANSPOSE4_PS(R[0], R[1], R[2], R[3]);
+			for (int k = 0; k < 4; k++){
+				_mm_storeu_ps(&xL[n + k][i], L[k]);
+				_mm_storeu_ps(&xR[n + k][i], R[k]);
+			}
+		}
+	}
+	for (; n < len; n++){
+		for (int i = 0; i < SF_COMPRESSOR_BATCHLANES; i++){
+			xL[n][i] = in[i][n].L;
+			xR[n][i] = in[i][n].R;
+		}
+	}
+}
+
+static inline void batch_transposeout(int len, sf_sample_st **out,
+	float xL[SF_COMPRESSOR_SPU][SF_COMPRESSOR_BATCHLANES],
+	float xR[SF_COMPRESSOR_SPU][SF_COMPRESSOR_BATCHLANES]){
+	int n = 0;
+	for (; n + 4 <= len; n += 4){
+		for (int i = 0; i < SF_COMPRESSOR_BATCHLANES; i += 4){
+			__m128 L[4], R[4];
+			for (int k = 0; k < 4; k++){
+				L[k] = _mm_loadu_ps(&xL[n + k][i]);
+				R[k] = _mm_loadu_ps(&xR[n + k][i]);
+			}
+			_MM_TRANSPOSE4_PS(L[0], L[1], L[2], L[3]);
+			_MM_TRANSPOSE4_PS(R[0], R[1], R[2], R[3]);
+			for (int k = 0; k < 4; k++){
+				_mm_storeu_ps(&out[i + k][n    ].L, _mm_unpacklo_ps(L[k], R[k]));
+				_mm_storeu_ps(&out[i + k][n + 2].L, _mm_unpackhi_ps(L[k], R[k]));
 			}
+		}
+	}
+	for (; n < len; n++){
+		for (int i = 0; i < SF_COMPRESSOR_BATCHLANES; i++)
+			out[i][n] = (sf_sample_st){ xL[n][i], xR[n][i] };
+	}
+}
+
+// run the compressor over a transposed block of one group of streams, all inside of the same
+// sub-chunk, overwriting the block in place with the output
+static inline void batch_compress(sf_compressor_batch batch, int lane0, int len, int writepos,
+	float xL[SF_COMPRESSOR_SPU][SF_COMPRESSOR_BATCHLANES],
+	float xR[SF_COMPRESSOR_SPU][SF_COMPRESSOR_BATCHLANES]){
+	const float dbperlog2 = 6.0205999f; // 20 * log10(2)
+	const __m128 vdb = _mm_set1_ps(dbperlog2);
+	const __m128 vdbinv = _mm_set1_ps(1.0f / dbperlog2);
+	const __m128 vone = _mm_set1_ps(1.0f);
+	const __m128 vabs = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+	int mask = batch->delaysize - 1;
+	float *delayL = &batch->delayL[(size_t)lane0 * batch->delaysize];
+	float *delayR = &batch->delayR[(size_t)lane0 * batch->delaysize];
+
+	for (int i = 0; i < SF_COMPRESSOR_BATCHLANES; i += 4){
+		int l = lane0 + i;
+		__m128 pregain  = _mm_loadu_ps(&batch->linearpregain[l]);
+		__m128 lt       = _mm_loadu_ps(&batch->linearthreshold[l]);
+		__m128 ltk      = _mm_loadu_ps(&batch->linearthresholdknee[l]);
+		__m128 k        = _mm_loadu_ps(&batch->k[l]);
+		__m128 slope    = _mm_loadu_ps(&batch->slope[l]);
+		__m128 coffset  = _mm_loadu_ps(&batch->curveoffset[l]);
+		__m128 cthresh  = _mm_loadu_ps(&batch->curvethreshold[l]);
+		__m128 satinv   = _mm_mul_ps(_mm_loadu_ps(&batch->satreleasesamplesinv[l]), vdbinv);
+		__m128 wetgain  = _mm_loadu_ps(&batch->wetgain[l]);
+		__m128 dry      = _mm_loadu_ps(&batch->dry[l]);
+		__m128 det      = _mm_loadu_ps(&batch->detectoravg[l]);
+		__m128 cg       = _mm_loadu_ps(&batch->compgain[l]);
+		__m128 sdg      = _mm_loadu_ps(&batch->scaleddesiredgain[l]);
+		__m128 er       = _mm_loadu_ps(&batch->enveloperate[l]);
+		__m128 attack   = _mm_cmplt_ps(er, vone);
+		const int *ds   = &batch->delaysamples[l];
+
+		for (int n = 0; n < len; n++){
+			int wpos = (writepos + n) & mask;
+			__m128 vL = _mm_mul_ps(_mm_loadu_ps(&xL[n][i]), pregain);
+			__m128 vR = _mm_mul_ps(_mm_loadu_ps(&xR[n][i]), pregain);
+			_mm_storeu_ps(&delayL[wpos * SF_COMPRESSOR_BATCHLANES + i], vL);
+			_mm_storeu_ps(&delayR[wpos * SF_COMPRESSOR_BATCHLANES + i], vR);
+			__m128 x = _mm_max_ps(_mm_and_ps(vL, vabs), _mm_and_ps(vR, vabs));
+
+			// compression curve above the knee, in dB
+			__m128 xdb = _mm_mul_ps(v_log2(_mm_max_ps(x, _mm_set1_ps(1e-30f))), vdb);
+			__m128 attdb = _mm_sub_ps(_mm_add_ps(coffset,
+				_mm_mul_ps(slope, _mm_sub_ps(xdb, cthresh))), xdb);
+			__m128 att = v_exp2(_mm_mul_ps(attdb, vdbinv));
 
-			float rate;
-			if (attenuation > detectoravg){ // if releasing
-				float attenuationdb = -lin2db(attenuation);
-				if (attenuationdb < 2.0f)
-					attenuationdb = 2.0f;
-				float dbpersample = attenuationdb * satreleasesamplesinv;
-				rate = db2lin(dbpersample) - 1.0f;
+			// inside of the knee, only calculated if a lane needs it
+			__m128 below = _mm_or_ps(_mm_cmplt_ps(x, lt), _mm_cmplt_ps(x, _mm_set1_ps(0.0001f)));
+			__m128 inknee = _mm_andnot_ps(below, _mm_cmplt_ps(x, ltk));
+			if (_mm_movemask_ps(inknee)){
+				__m128 e = v_exp2(_mm_mul_ps(_mm_mul_ps(k, _mm_sub_ps(lt, x)),
+					_mm_set1_ps(1.4426950f))); // exp(-k * (x - lt))
+				__m128 kneeatt = _mm_div_ps(_mm_add_ps(lt, _mm_div_ps(_mm_sub_ps(vone, e), k)), x);
+				att = v_select(inknee, kneeatt, att);
+				attdb = v_select(inknee, _mm_mul_ps(v_log2(kneeatt), vdb), attdb);
 			}
+			att = v_select(below, vone, att);
+			attdb = _mm_andnot_ps(below, attdb);
+
+			// detector, releasing at a rate based on the attenuation
+			__m128 rdb = _mm_max_ps(_mm_sub_ps(_mm_setzero_ps(), attdb), _mm_set1_ps(2.0f));
+			__m128 rate = _mm_sub_ps(v_exp2(_mm_mul_ps(rdb, satinv)), vone);
+			rate = v_select(_mm_cmpgt_ps(att, det), rate, vone);
+			det = _mm_add_ps(det, _mm_mul_ps(_mm_sub_ps(att, det), rate));
+			det = _mm_min_ps(det, vone);
+			det = v_select(_mm_cmpord_ps(det, det), det, vone);
+
+			// envelope
+			__m128 cgattack = _mm_add_ps(cg, _mm_mul_ps(_mm_sub_ps(sdg, cg), er));
+			__m128 cgrelease = _mm_min_ps(_mm_mul_ps(cg, er), vone);
+			cg = v_select(attack, cgattack, cgrelease);
+
+			// apply the gain to the delayed input
+			__m128 gain = _mm_add_ps(dry, _mm_mul_ps(wetgain, v_sin90(cg)));
+			int r0 = ((writepos + n - ds[0]) & mask) * SF_COMPRESSOR_BATCHLANES + i;
+			int r1 = ((writepos + n - ds[1]) & mask) * SF_COMPRESSOR_BATCHLANES + i + 1;
+			int r2 = ((writepos + n - ds[2]) & mask) * SF_COMPRESSOR_BATCHLANES + i + 2;
+			int r3 = ((writepos + n - ds[3]) & mask) * SF_COMPRESSOR_BATCHLANES + i + 3;
+			__m128 dL = _mm_setr_ps(delayL[r0], delayL[r1], delayL[r2], delayL[r3]);
+			__m128 dR = _mm_setr_ps(delayR[r0], delayR[r1], delayR[r2], delayR[r3]);
+			_mm_storeu_ps(&xL[n][i], _mm_mul_ps(dL, gain));
+			_mm_storeu_ps(&xR[n][i], _mm_mul_ps(dR, gain));
+		}
+
+		_mm_storeu_ps(&batch->detectoravg[l], det);
+		_mm_storeu_ps(&batch->compgain[l], cg);
+	}
+}
+#else
+static inline void batch_transposein(int len, sf_sample_st **in,
+	float xL[SF_COMPRESSOR_SPU][SF_COMPRESSOR_BATCHLANES],
+	float xR[SF_COMPRESSOR_SPU][SF_COMPRESSOR_BATCHLANES]){
+	for (int n = 0; n < len; n++){
+		for (int i = 0; i < SF_COMPRESSOR_BATCHLANES; i++){
+			xL[n][i] = in[i][n].L;
+			xR[n][i] = in[i][n].R;
+		}
+	}
+}
+
+static inline void batch_transposeout(int len, sf_sample_st **out,
+	float xL[SF_COMPRESSOR_SPU][SF_COMPRESSOR_BATCHLANES],
+	float xR[SF_COMPRESSOR_SPU][SF_COMPRESSOR_BATCHLANES]){
+	for (int n = 0; n < len; n++){
+		for (int i = 0; i < SF_COMPRESSOR_BATCHLANES; i++)
+			out[i][n] = (sf_sample_st){ xL[n][i], xR[n][i] };
+	}
+}
+
+// without SIMD, each lane uses the exact per-sample math, besides the sine of the gain law
+static inline void batch_compress(sf_compressor_batch batch, int lane0, int len, int writepos,
+	float xL[SF_COMPRESSOR_SPU][SF_COMPRESSOR_BATCHLANES],
+	float xR[SF_COMPRESSOR_SPU][SF_COMPRESSOR_BATCHLANES]){
+	int mask = batch->delaysize - 1;
+	float *delayL = &batch->delayL[(size_t)lane0 * batch->delaysize];
+	float *delayR = &batch->delayR[(size_t)lane0 * batch->delaysize];
+
+	for (int i = 0; i < SF_COMPRESSOR_BATCHLANES; i++){
+		int l = lane0 + i;
+		float pregain = batch->linearpregain[l];
+		float lt      = batch->linearthreshold[l];
+		float ltk     = batch->linearthresholdknee[l];
+		float k       = batch->k[l];
+		float slope   = batch->slope[l];
+		float coffset = batch->curveoffset[l];
+		float cthresh = batch->curvethreshold[l];
+		float satinv  = batch->satreleasesamplesinv[l];
+		float wetgain = batch->wetgain[l];
+		float dry     = batch->dry[l];
+		float det     = batch->detectoravg[l];
+		float cg      = batch->compgain[l];
+		float sdg     = batch->scaleddesiredgain[l];
+		float er      = batch->enveloperate[l];
+		int ds        = batch->delaysamples[l];
+
+		for (int n = 0; n < len; n++){
+			int wpos = (writepos + n) & mask;
+			float vL = xL[n][i] * pregain;
+			float vR = xR[n][i] * pregain;
+			delayL[wpos * SF_COMPRESSOR_BATCHLANES + i] = vL;
+			delayR[wpos * SF_COMPRESSOR_BATCHLANES + i] = vR;
+			float x = absf(vL) > absf(vR) ? absf(vL) : absf(vR);
+
+			float att;
+			if (x < lt || x < 0.0001f)
+				att = 1.0f;
+			else if (x < ltk)
+				att = kneecurve(x, k, lt) / x;
 			else
-				rate = 1.0f;
-
-			detectoravg += (attenuation - detectoravg) * rate;
-			if (detectoravg > 1.0f)
-				detectoravg = 1.0f;
-			detectoravg = fixf(detectoravg, 1.0f);
-
-			if (enveloperate < 1) // attack, reduce gain
-				compgain += (scaleddesiredgain - compgain) * enveloperate;
-			else{ // release, increase gain
-				compgain *= enveloperate;
-				if (compgain > 1.0f)
-					compgain = 1.0f;
+				att = db2lin(coffset + slope * (lin2db(x) - cthresh)) / x;
+
+			float rate = 1.0f;
+			if (att > det){
+				float attdb = -lin2db(att);
+				if (attdb < 2.0f)
+					attdb = 2.0f;
+				rate = db2lin(attdb * satinv) - 1.0f;
 			}
+			det += (att - det) * rate;
+			if (det > 1.0f)
+				det = 1.0f;
+			det = fixf(det, 1.0f);
 
-			// the final gain value!
-			float premixgain = sinf(ang90 * compgain);
-			float gain = dry + wet * mastergain * premixgain;
+			if (er < 1)
+				cg += (sdg - cg) * er;
+			else{
+				cg *= er;
+				if (cg > 1.0f)
+					cg = 1.0f;
+			}
 
-			// calculate metering (not used in core algo, but used to output a meter if desired)
-			float premixgaindb = lin2db(premixgain);
-			if (premixgaindb < metergain)
-				metergain = premixgaindb; // spike immediately
-			else
-				metergain += (premixgaindb - metergain) * meterrelease; // fall slowly
+			float gain = dry + wetgain * fastsin90(cg);
+			int rpos = ((writepos + n - ds) & mask) * SF_COMPRESSOR_BATCHLANES + i;
+			xL[n][i] = delayL[rpos] * gain;
+			xR[n][i] = delayR[rpos] * gain;
+		}
+
+		batch->detectoravg[l] = det;
+		batch->compgain[l]    = cg;
+	}
+}
+#endif
+
+void sf_compressor_batch_process(sf_compressor_batch batch, int size, sf_sample_st **input,
+	sf_sample_st **output){
+	sf_denormal_st dn;
+	sf_denormal_begin(&dn);
+	float xL[SF_COMPRESSOR_SPU][SF_COMPRESSOR_BATCHLANES];
+	float xR[SF_COMPRESSOR_SPU][SF_COMPRESSOR_BATCHLANES];
+	sf_sample_st zero[SF_COMPRESSOR_SPU] = {{ 0 }};
+	sf_sample_st scratch[SF_COMPRESSOR_SPU];
+	int chunkpos = batch->chunkpos;
+	int writepos = batch->delaywritepos;
+
+	for (int lane0 = 0; lane0 < batch->lanes; lane0 += SF_COMPRESSOR_BATCHLANES){
+		// every group starts from the same position in the sub-chunk and the predelay rings
+		chunkpos = batch->chunkpos;
+		writepos = batch->delaywritepos;
+		for (int pos = 0; pos < size; ){
+			// the envelope is only updated once per sub-chunk, so it uses the exact math
+			if (chunkpos == 0){
+				for (int l = lane0; l < lane0 + SF_COMPRESSOR_BATCHLANES; l++){
+					envelope(&batch->detectoravg[l], batch->compgain[l], &batch->maxcompdiffdb[l],
+						batch->a[l], batch->b[l], batch->c[l], batch->d[l],
+						batch->attacksamplesinv[l], false, &batch->scaleddesiredgain[l],
+						&batch->enveloperate[l]);
+				}
+			}
+
+			int len = SF_COMPRESSOR_SPU - chunkpos;
+			if (len > size - pos)
+				len = size - pos;
+
+			sf_sample_st *in[SF_COMPRESSOR_BATCHLANES], *out[SF_COMPRESSOR_BATCHLANES];
+			for (int i = 0; i < SF_COMPRESSOR_BATCHLANES; i++){
+				bool used = lane0 + i < batch->count;
+				in [i] = used ? &input [lane0 + i][pos] : zero;
+				out[i] = used ? &output[lane0 + i][pos] : scratch;
+			}
+
+			batch_transposein(len, in, xL, xR);
+			batch_compress(batch, lane0, len, writepos, xL, xR);
+			batch_transposeout(len, out, xL, xR);
 
-			// apply the gain
-			output[samplepos] = (sf_sample_st){
-				.L = delaybuf[delayreadpos].L * gain,
-				.R = delaybuf[delayreadpos].R * gain
-			};
+			pos += len;
+			chunkpos = (chunkpos + len) % SF_COMPRESSOR_SPU;
+			writepos = (writepos + len) & (batch->delaysize - 1);
 		}
 	}
 
-	state->metergain     = metergain;
-	state->detectoravg   = detectoravg;
-	state->compgain      = compgain;
-	state->maxcompdiffdb = maxcompdiffdb;
-	state->delaywritepos = delaywritepos;
-	state->delayreadpos  = delayreadpos;
+	batch->chunkpos = chunkpos;
+	batch->delaywritepos = writepos;
+	sf_denormal_end(&dn);
 }
@@ -26,27 +26,66 @@
 //   for each 128 length sample:
 //     sf_compressor_process(&simplecomp, 128, input, output);
 //
+//   sf_compressor_free(&simplecomp);
+//
+// the predelay buffer is allocated when the state is initialized, so the state must be freed with
+// sf_compressor_free when it's no longer needed (including before initializing it again)
+//
 // notice that sf_compressor_process will change a lot of the member variables inside of the state
 // structure, since these values must be carried over across chunk boundaries
 //
 // also notice that the choice to divide the sound into chunks of 128 samples is completely
-// arbitrary from the compressor's perspective, however, the size should be divisible by the SPU
-// value below (defaults to 32):
-
-// maximum number of samples in the delay buffer
-#define SF_COMPRESSOR_MAXDELAY   1024
+// arbitrary from the compressor's perspective; internally, the envelope is only updated once every
+// SPU samples (see below, and sf_compressor_controlrate), but a partial sub-chunk at the end of a
+// call is carried over to the next call, so any chunk size can be used (even one that changes from
+// call to call), and the output is the same as processing the whole sound at once
 
 // samples per update; the compressor works by dividing the input chunks into even smaller sizes,
 // and performs heavier calculations after each mini-chunk to adjust the final envelope
 #define SF_COMPRESSOR_SPU        32
 
+// samples computed by each phase of the processing loop at a time (see compressor.c)
+#define SF_COMPRESSOR_KERNELBLOCK 32
+
+// largest samples per update allowed by sf_compressor_controlrate
+#define SF_COMPRESSOR_MAXSPU     4096
+
 // not sure what this does exactly, but it is part of the release curve
 #define SF_COMPRESSOR_SPACINGDB  5.0f
 
+// lookup table mode (see sf_compressor_lut); the table covers input levels (after pregain) from
+// 2^LUTMINEXP to 2^LUTMAXEXP (-84dB to +48dB), with 2^LUTBITS entries per octave
+#define SF_COMPRESSOR_LUTMINEXP  -14
+#define SF_COMPRESSOR_LUTMAXEXP  8
+#define SF_COMPRESSOR_LUTBITS    5
+#define SF_COMPRESSOR_LUTSTEPS   (1 << SF_COMPRESSOR_LUTBITS)
+#define SF_COMPRESSOR_LUTSIZE    \
+	((SF_COMPRESSOR_LUTMAXEXP - SF_COMPRESSOR_LUTMINEXP) * SF_COMPRESSOR_LUTSTEPS + 1)
+
+// block meter, written after every process call when attached with sf_compressor_meter; all values
+// are in dB, and describe only the samples of that call
+//
+// the input levels are measured before the pregain (so 0dB is full scale), over every channel; the
+// gain is the compression part of the gain (not including the postgain or the wet/dry mix), so 0dB
+// means no compression; the average gain is averaged in linear units, and then converted to dB
+//
+// silence gives -infinity for the input levels
+typedef struct {
+	float inputpeak; // peak input level
+	float inputrms;  // RMS input level
+	float gainmin;   // most compression
+	float gainmax;   // least compression
+	float gainavg;   // average compression
+} sf_compressor_meter_st;
+
 typedef struct {
 	// user can read the metergain state variable after processing a chunk to see how much dB the
 	// compressor would have liked to compress the sample; the meter values aren't used to shape the
 	// sound in any way, only used for output if desired
+	//
+	// metergain is smoothed every sample, which takes a log per sample; if a block meter is
+	// attached (see sf_compressor_meter), metergain isn't updated, and if SF_COMPRESSOR_NOMETER is
+	// defined when compiling compressor.c, all metering is removed
 	float metergain;
 
 	// everything else shouldn't really be mucked with unless you read the algorithm and feel
@@ -72,17 +111,30 @@ typedef struct {
 	float detectoravg;
 	float compgain;
 	float maxcompdiffdb;
-	int delaybufsize;
+	float scaleddesiredgain; // envelope of the current sub-chunk
+	float enveloperate;
+	int chunkpos;            // position inside of the current sub-chunk
+	int spu;                 // samples per envelope update (see sf_compressor_controlrate)
+	int decimate;            // samples per detector update
+	int decimatepos;         // position inside of the current detector group
+	float decimatepeak;      // peak of the current detector group
+	int channels;            // number of interleaved channels (2 unless sf_compressor_channels)
+	int delaysamples;        // predelay, in samples
+	int delaysize;           // size of the predelay ring (a power of 2), or 0 for no predelay
+	int delaymask;
 	int delaywritepos;
 	int delayreadpos;
-	sf_sample_st delaybuf[SF_COMPRESSOR_MAXDELAY]; // predelay buffer
+	float *delaybuf;         // predelay ring, with `channels` values per sample
+	float *lut;              // lookup table, or NULL for the exact calculations
+	sf_compressor_meter_st *meter; // block meter, or NULL
 } sf_compressor_state_st;
 
 // populate a compressor state with all default values
-void sf_defaultcomp(sf_compressor_state_st *state, int rate);
+// (the init functions return false for error)
+bool sf_defaultcomp(sf_compressor_state_st *state, int rate);
 
 // populate a compressor state with simple parameters
-void sf_simplecomp(sf_compressor_state_st *state,
+bool sf_simplecomp(sf_compressor_state_st *state,
 	int rate,        // input sample rate (samples per second)
 	float pregain,   // dB, amount to boost the signal before applying compression [0 to 100]
 	float threshold, // dB, level where compression kicks in [-100 to 0]
@@ -93,11 +145,11 @@ void sf_simplecomp(sf_compressor_state_st *state,
 );
 
 // populate a compressor state with advanced parameters
-void sf_advancecomp(sf_compressor_state_st *state,
+bool sf_advancecomp(sf_compressor_state_st *state,
 	// these parameters are the same as the simple version above:
 	int rate, float pregain, float threshold, float knee, float ratio, float attack, float release,
 	// these are the advanced parameters:
-	float predelay,     // seconds, length of the predelay buffer [0 to 1]
+	float predelay,     // seconds, length of the predelay buffer [0 to 1], 0 for no latency
 	float releasezone1, // release zones should be increasing between 0 and 1, and are a fraction
 	float releasezone2, //  of the release time depending on the input dB -- these parameters define
 	float releasezone3, //  the adaptive release curve, which is discussed in further detail in the
@@ -106,9 +158,189 @@ void sf_advancecomp(sf_compressor_state_st *state,
 	float wet           // amount to apply the effect [0 completely dry to 1 completely wet]
 );
 
+// free the predelay buffer of an initialized state
+void sf_compressor_free(sf_compressor_state_st *state);
+
+// attach a block meter, which is written after each process call instead of updating metergain
+// every sample (NULL to go back to metergain); the meter is owned by the caller
+//
+// if SF_COMPRESSOR_NOMETER is defined when compiling compressor.c, this only zeroes the meter, and
+// it's never written after that
+void sf_compressor_meter(sf_compressor_state_st *state, sf_compressor_meter_st *meter);
+
+// turn the lookup table mode on or off (it starts off); instead of evaluating the compression curve
+// with exp/pow/log for every sample, it's sampled into a table when enabled, and the sine and
+// arcsine of the gain law use polynomial approximations
+//
+// the table is about 5.6KB, and is freed by sf_compressor_free; reinitializing the state turns the
+// mode off again; input levels above the table (+48dB) still use the exact curve
+//
+// compared to the exact calculations, the error of each piece is:
+//   compression curve   below 0.002dB with a knee, and up to 0.025dB next to a hard knee (knee = 0)
+//   gain law            below 2e-7 (sine and arcsine)
+//   metergain           below 0.0002dB
+// so the gain applied to the output stays within a few hundredths of a dB of the exact path
+// (returns false for error)
+bool sf_compressor_lut(sf_compressor_state_st *state, bool enable);
+
+// change how often the envelope and detector are updated (states start with SF_COMPRESSOR_SPU and
+// 1); the envelope is updated once every spu samples [1 to SF_COMPRESSOR_MAXSPU], and the detector
+// once every decimate samples, which must divide spu evenly
+//
+// the envelope update is the heavy part of each sub-chunk, so a small spu (like 8) follows fast
+// transients more tightly for limiting, and a large spu (like 128) is cheaper for background sounds
+//
+// a decimated detector takes the peak of each group of samples, and runs the compression curve once
+// for the group, with the release rate scaled to cover the whole group; this saves the log and pow
+// of every sample besides the last in each group (or the table lookup, in lookup table mode), and
+// since the peak is used, short peaks inside of a group still reach the detector
+//
+// this starts a new sub-chunk (returns false if the values are out of range)
+bool sf_compressor_controlrate(sf_compressor_state_st *state, int spu, int decimate);
+
+// set the number of interleaved channels for sf_compressor_processn (states start with 2); this
+// reallocates and clears the predelay buffer (returns false for error)
+bool sf_compressor_channels(sf_compressor_state_st *state, int channels);
+
 // this function will process the input sound based on the state passed
 // the input and output buffers should be the same size
-void sf_compressor_process(sf_compressor_state_st *state, int size, sf_sample_st *input,
+// (the process functions return false for error, such as a channel count that doesn't match the
+// state, and then leave the output alone)
+bool sf_compressor_process(sf_compressor_state_st *state, int size, sf_sample_st *input,
 	sf_sample_st *output);
 
+// same as above, for an N-channel sound with interleaved samples (see sf_sndn_st); every channel is
+// scaled by the same gain, which is based on the loudest channel, so the image doesn't shift
+//
+// the channel count must match sf_compressor_channels (sf_compressor_process requires 2), and for
+// stereo the output is identical to sf_compressor_process
+bool sf_compressor_processn(sf_compressor_state_st *state, int channels, int size, float *input,
+	float *output);
+
+// sidechains
+//
+// normally the compressor reacts to its own input; with a sidechain, the detector follows a
+// separate key signal instead, and the gain is applied to the input (for example, ducking music
+// under a voice over, with the voice over as the key):
+//
+//   for each 128 length sample:
+//     sf_compressor_sidechain(&comp, 128, music, voiceover, output);
+//
+// the key goes through the pregain like the input does, and isn't delayed by the predelay, so the
+// predelay lets the gain drop before a loud part of the key reaches the output; if a block meter is
+// attached, the input levels are measured from the key
+//
+// the key can also drive several sounds at once with the same gain (linking the stems of a mix, for
+// example), by only running the detector once, and then applying the gains to each stem:
+//
+//   float gains[128];
+//   for each 128 length sample:
+//     sf_compressor_gain(&comp, 2, 128, (float *)mixbus, gains);
+//     for each stem:
+//       sf_compressor_applygain(2, 128, gains, (float *)stem, (float *)stemout);
+//
+// gains[n] is the total gain of sample n, including the pregain, postgain, and wet/dry mix; since
+// the stems aren't stored by the state, the predelay is ignored, so for a lookahead the stems
+// should be delayed by the caller by state->delaysamples; a state used with sf_compressor_gain
+// shouldn't also be used to process sound
+
+// same as sf_compressor_process, with the detector following key instead of input (key should be
+// the same size as input)
+bool sf_compressor_sidechain(sf_compressor_state_st *state, int size, sf_sample_st *input,
+	sf_sample_st *key, sf_sample_st *output);
+
+// same as above, for N-channel sounds with interleaved samples; the channel count of the input must
+// match sf_compressor_channels, but the key can have any number of channels
+bool sf_compressor_sidechainn(sf_compressor_state_st *state, int channels, int size,
+	float *input, int keychannels, float *key, float *output);
+
+// run the detector over `size` samples of an interleaved key with keychannels channels, and write
+// the gain of each sample to gains
+bool sf_compressor_gain(sf_compressor_state_st *state, int keychannels, int size, float *key,
+	float *gains);
+
+// multiply each sample of an interleaved sound by its gain from sf_compressor_gain
+void sf_compressor_applygain(int channels, int size, const float *gains, float *input,
+	float *output);
+
+// batches
+//
+// when running many compressors at once (one per voice in a game, for example), a batch stores the
+// parameters and running state of every stream in structure-of-arrays form, so that the per-sample
+// work of several streams is computed with a single SIMD instruction
+//
+// for example, for 256 voices that each have their own settings:
+//
+//   sf_compressor_batch batch = sf_compressor_batch_new(256, 1024);
+//   for each voice i:
+//     sf_compressor_state_st comp;
+//     sf_simplecomp(&comp, 48000, pregain[i], threshold[i], 30, ratio[i], 0.003f, 0.250f);
+//     sf_compressor_batch_set(batch, i, &comp);
+//     sf_compressor_free(&comp);
+//
+//   for each 128 length sample:
+//     sf_compressor_batch_process(batch, 128, inputs, outputs);
+//
+// where inputs and outputs are arrays of 256 pointers to each voice's 128 samples
+//
+// the per-sample math uses polynomial approximations of log2, exp2 and sine (like the lookup table
+// mode, sf_compressor_lut), so the gain of each stream is close to, but not exactly, the gain of
+// sf_compressor_process; metergain isn't calculated
+//
+// every stream in a batch updates its envelope on the same sub-chunk schedule, so a stream added
+// in the middle of a sub-chunk starts its first envelope early
+
+// number of streams processed together; should be a multiple of the widest SIMD register
+#define SF_COMPRESSOR_BATCHLANES 16
+
+typedef struct {
+	int count;        // number of streams
+	int lanes;        // count rounded up to a multiple of SF_COMPRESSOR_BATCHLANES
+	int delaysize;    // size of every stream's predelay ring (a power of 2)
+	int delaywritepos;
+	int chunkpos;     // position inside of the current sub-chunk, shared by every stream
+	// parameters for each stream
+	float *linearpregain;
+	float *linearthreshold;
+	float *linearthresholdknee; // 0 if there is no knee
+	float *k;
+	float *slope;
+	float *curveoffset;         // the curve above the knee is, in dB:
+	float *curvethreshold;      //   curveoffset + slope * (input - curvethreshold)
+	float *satreleasesamplesinv;
+	float *attacksamplesinv;
+	float *wetgain;             // wet * mastergain
+	float *dry;
+	float *a, *b, *c, *d;
+	int *delaysamples;
+	// state for each stream
+	float *detectoravg;
+	float *compgain;
+	float *maxcompdiffdb;
+	float *scaleddesiredgain;
+	float *enveloperate;
+	float *delayL;    // predelay rings, in groups of SF_COMPRESSOR_BATCHLANES streams
+	float *delayR;
+	float *data;      // storage for all of the above
+} sf_compressor_batch_st, *sf_compressor_batch;
+
+// create a batch of `count` streams, which can each have a predelay of up to `maxdelay` samples;
+// the streams start out as compressors that don't change the sound
+sf_compressor_batch sf_compressor_batch_new(int count, int maxdelay); // returns NULL for error
+void                sf_compressor_batch_free(sf_compressor_batch batch);
+
+// copy the parameters and running state of a stereo state into the stream at index (returns false
+// if the state's predelay is longer than the batch allows, it isn't stereo, or its control rate was
+// changed from the default)
+bool sf_compressor_batch_set(sf_compressor_batch batch, int index,
+	const sf_compressor_state_st *state);
+
+// copy the running state of the stream at index back into a state that was initialized with the
+// same parameters (returns false if its predelay doesn't match, or it isn't stereo)
+bool sf_compressor_batch_get(sf_compressor_batch batch, int index, sf_compressor_state_st *state);
+
+// input and output are arrays of batch->count pointers, each pointing to `size` samples
+void sf_compressor_batch_process(sf_compressor_batch batch, int size, sf_sample_st **input,
+	sf_sample_st **output);
+
 #endif // SNDFILTER_COMPRESSOR__H
@@ -0,0 +1,378 @@
+//
+// sndfilter - Algorithms for sound filters, like reverb, lowpass, etc
+// by Sean Connelly (@velipso), https://sean.fun
+// Project Home: https://github.com/velipso/sndfilter
+// SPDX-License-Identifier: 0BSD
+//
+
+#include "convolve.h"
+#include "denormal.h"
+#include "mem.h"
+#include <math.h>
+#include <string.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// convolving with an impulse response that is seconds long is far too slow to do directly, so the
+// impulse response is split into partitions of B samples, and each partition is applied in the
+// frequency domain, where convolution becomes multiplication
+//
+// every B samples, the last 2B samples of input are transformed with an FFT (overlap-save), and the
+// spectrum is saved in a delay line; the spectrum of the output block is the sum of each saved
+// spectrum multiplied by the matching partition of the impulse response, and the last B samples of
+// its inverse FFT are the output
+//
+// the FFT of 2B real samples is done with a complex FFT of B values, by packing the even samples
+// into the real part and the odd samples into the imaginary part, then splitting the result apart
+//
+// spectra are stored as B real values followed by B imaginary values; bin 0 (DC) and bin B
+// (Nyquist) are both real, so the Nyquist value is stored in the imaginary slot of bin 0
+
+// complex FFT of size m, in place, without scaling
+//
+// calling it with the real and imaginary arrays swapped performs the inverse FFT (also without
+// scaling), because swapping the parts is the same as conjugating and multiplying by i
+static void fft(sf_convolve cv, float *re, float *im){
+	int m = cv->blocksize;
+
+	// bit reverse permutation
+	for (int i = 0; i < m; i++){
+		int j = cv->bitrev[i];
+		if (i < j){
+			float t = re[i]; re[i] = re[j]; re[j] = t;
+			t = im[i]; im[i] = im[j]; im[j] = t;
+		}
+	}
+
+	// first two stages have trivial twiddles (1, and -i)
+	for (int i = 0; i < m; i += 4){
+		float r0 = re[i    ] + re[i + 1], i0 = im[i    ] + im[i + 1];
+		float r1 = re[i    ] - re[i + 1], i1 = im[i    ] - im[i + 1];
+		float r2 = re[i + 2] + re[i + 3], i2 = im[i + 2] + im[i + 3];
+		float r3 = re[i + 2] - re[i + 3], i3 = im[i + 2] - im[i + 3];
+		re[i    ] = r0 + r2; im[i    ] = i0 + i2;
+		re[i + 2] = r0 - r2; im[i + 2] = i0 - i2;
+		re[i + 1] = r1 + i3; im[i + 1] = i1 - r3;
+		re[i + 3] = r1 - i3; im[i + 3] = i1 + r3;
+	}
+
+	// the rest of the stages, four butterflies at a time; the twiddles for the stage with half
+	// size h are stored at costbl[h] to costbl[2h - 1]
+	for (int h = 4; h < m; h <<= 1){
+		const float *wr = &cv->costbl[h];
+		const float *wi = &cv->sintbl[h];
+		for (int g = 0; g < m; g += h * 2){
+			float *ar = &re[g], *ai = &im[g];
+			float *br = &re[g + h], *bi = &im[g + h];
+			for (int k = 0; k < h; k += 4){
+#if defined(__SSE2__)
+				__m128 cr = _mm_loadu_ps(&wr[k]);
+				__m128 ci = _mm_loadu_ps(&wi[k]);
+				__m128 xr = _mm_loadu_ps(&br[k]);
+				__m128 xi = _mm_loadu_ps(&bi[k]);
+				__m128 tr = _mm_sub_ps(_mm_mul_ps(xr, cr), _mm_mul_ps(xi, ci));
+				__m128 ti = _mm_add_ps(_mm_mul_ps(xr, ci), _mm_mul_ps(xi, cr));
+				__m128 yr = _mm_loadu_ps(&ar[k]);
+				__m128 yi = _mm_loadu_ps(&ai[k]);
+				_mm_storeu_ps(&br[k], _mm_sub_ps(yr, tr));
+				_mm_storeu_ps(&bi[k], _mm_sub_ps(yi, ti));
+				_mm_storeu_ps(&ar[k], _mm_add_ps(yr, tr));
+				_mm_storeu_ps(&ai[k], _mm_add_ps(yi, ti));
+#else
+				for (int k2 = k; k2 < k + 4; k2++){
+					float tr = br[k2] * wr[k2] - bi[k2] * wi[k2];
+					float ti = br[k2] * wi[k2] + bi[k2] * wr[k2];
+					br[k2] = ar[k2] - tr;
+					bi[k2] = ai[k2] - ti;
+					ar[k2] += tr;
+					ai[k2] += ti;
+				}
+#endif
+			}
+		}
+	}
+}
+
+// FFT of 2m real samples into a packed spectrum
+static void rfft(sf_convolve cv, const float *x, float *re, float *im){
+	int m = cv->blocksize;
+	for (int k = 0; k < m; k++){
+		re[k] = x[k * 2];
+		im[k] = x[k * 2 + 1];
+	}
+	fft(cv, re, im);
+
+	// split the spectrum of the even samples (E) and the odd samples (O) out of the complex result
+	// Z, then combine them into X[k] = E[k] + W^k O[k], where W^k = e^(-pi i k / m)
+	float z0 = re[0];
+	re[0] = z0 + im[0];
+	im[0] = z0 - im[0];
+	for (int k = 1; k <= m / 2; k++){
+		int j = m - k;
+		float er = 0.5f * (re[k] + re[j]);
+		float ei = 0.5f * (im[k] - im[j]);
+		float odr = 0.5f * (im[k] + im[j]);
+		float odi = 0.5f * (re[j] - re[k]);
+		float tr = cv->rcos[k] * odr + cv->rsin[k] * odi;
+		float ti = cv->rcos[k] * odi - cv->rsin[k] * odr;
+		// X[m - k] is the conjugate of E[k] - W^k O[k]
+		re[k] = er + tr;
+		im[k] = ei + ti;
+		re[j] = er - tr;
+		im[j] = ti - ei;
+	}
+}
+
+// inverse of rfft, except the output is scaled by 2m; destroys the spectrum
+static void irfft(sf_convolve cv, float *re, float *im, float *x){
+	int m = cv->blocksize;
+
+	// rebuild Z[k] = E[k] + i O[k], where E[k] = X[k] + conj(X[m - k]) and
+	// O[k] = (X[k] - conj(X[m - k])) conj(W^k), which are each twice their value in rfft
+	float x0 = re[0];
+	re[0] = x0 + im[0];
+	im[0] = x0 - im[0];
+	for (int k = 1; k <= m / 2; k++){
+		int j = m - k;
+		float er = re[k] + re[j];
+		float ei = im[k] - im[j];
+		float dr = re[k] - re[j];
+		float di = im[k] + im[j];
+		float odr = dr * cv->rcos[k] - di * cv->rsin[k];
+		float odi = dr * cv->rsin[k] + di * cv->rcos[k];
+		re[k] = er - odi;
+		im[k] = ei + odr;
+		re[j] = er + odi;
+		im[j] = odr - ei;
+	}
+
+	fft(cv, im, re);
+	for (int k = 0; k < m; k++){
+		x[k * 2] = re[k];
+		x[k * 2 + 1] = im[k];
+	}
+}
+
+// multiply two packed spectra and add the result to acc
+static void mac(float *acc, const float *x, const float *h, int m){
+	// DC and Nyquist are real, so they're multiplied separately
+	float dc = acc[0] + x[0] * h[0];
+	float ny = acc[m] + x[m] * h[m];
+	float *ar = acc, *ai = &acc[m];
+	const float *xr = x, *xi = &x[m];
+	const float *hr = h, *hi = &h[m];
+#if defined(__SSE2__)
+	for (int k = 0; k < m; k += 4){
+		__m128 vxr = _mm_loadu_ps(&xr[k]);
+		__m128 vxi = _mm_loadu_ps(&xi[k]);
+		__m128 vhr = _mm_loadu_ps(&hr[k]);
+		__m128 vhi = _mm_loadu_ps(&hi[k]);
+		__m128 vr = _mm_sub_ps(_mm_mul_ps(vxr, vhr), _mm_mul_ps(vxi, vhi));
+		__m128 vi = _mm_add_ps(_mm_mul_ps(vxr, vhi), _mm_mul_ps(vxi, vhr));
+		_mm_storeu_ps(&ar[k], _mm_add_ps(_mm_loadu_ps(&ar[k]), vr));
+		_mm_storeu_ps(&ai[k], _mm_add_ps(_mm_loadu_ps(&ai[k]), vi));
+	}
+#else
+	for (int k = 0; k < m; k++){
+		ar[k] += xr[k] * hr[k] - xi[k] * hi[k];
+		ai[k] += xr[k] * hi[k] + xi[k] * hr[k];
+	}
+#endif
+	acc[0] = dc;
+	acc[m] = ny;
+}
+
+sf_convolve sf_convolve_new(int blocksize, int size, const sf_sample_st *irL,
+	const sf_sample_st *irR){
+	if (blocksize < SF_CONVOLVE_MINBLOCK || blocksize > SF_CONVOLVE_MAXBLOCK ||
+		(blocksize & (blocksize - 1)) != 0 || size < 0 || irL == NULL)
+		return NULL;
+
+	int m = blocksize;
+	int paths = irR == NULL ? 2 : 4;
+	int partitions = size < 1 ? 1 : (size + m - 1) / m;
+
+	sf_convolve cv = sf_malloc(sizeof(sf_convolve_st));
+	if (cv == NULL)
+		return NULL;
+	cv->bitrev = sf_malloc(sizeof(int) * m);
+	// costbl, sintbl, rcos, rsin, ir, fdl, inbuf, outbuf, work
+	size_t total = (size_t)m * 4 + (size_t)paths * partitions * m * 2 +
+		(size_t)2 * partitions * m * 2 + (size_t)m * 4 + (size_t)m * 2 + (size_t)m * 4;
+	cv->data = sf_malloc(sizeof(float) * total);
+	if (cv->bitrev == NULL || cv->data == NULL){
+		if (cv->bitrev)
+			sf_free(cv->bitrev);
+		if (cv->data)
+			sf_free(cv->data);
+		sf_free(cv);
+		return NULL;
+	}
+	memset(cv->data, 0, sizeof(float) * total);
+
+	cv->blocksize  = m;
+	cv->partitions = partitions;
+	cv->paths      = paths;
+	cv->pos        = 0;
+	cv->fdlpos     = 0;
+	cv->costbl     = cv->data;
+	cv->sintbl     = &cv->costbl[m];
+	cv->rcos       = &cv->sintbl[m];
+	cv->rsin       = &cv->rcos[m];
+	cv->ir         = &cv->rsin[m];
+	cv->fdl        = &cv->ir[(size_t)paths * partitions * m * 2];
+	cv->inbuf      = &cv->fdl[(size_t)2 * partitions * m * 2];
+	cv->outbuf     = &cv->inbuf[m * 4];
+	cv->work       = &cv->outbuf[m * 2];
+
+	// bit reverse permutation
+	int bits = 0;
+	while ((1 << bits) < m)
+		bits++;
+	for (int i = 0; i < m; i++){
+		int r = 0;
+		for (int b = 0; b < bits; b++)
+			r |= ((i >> b) & 1) << (bits - 1 - b);
+		cv->bitrev[i] = r;
+	}
+
+	// twiddles for each stage of the complex FFT: e^(-pi i k / h), for k = 0 to h - 1
+	for (int h = 1; h < m; h <<= 1){
+		for (int k = 0; k < h; k++){
+			double a = M_PI * k / h;
+			cv->costbl[h + k] = (float)cos(a);
+			cv->sintbl[h + k] = (float)-sin(a);
+		}
+	}
+
+	// twiddles for splitting the real FFT: W^k = rcos[k] - i rsin[k]
+	for (int k = 0; k <= m / 2; k++){
+		double a = M_PI * k / m;
+		cv->rcos[k] = (float)cos(a);
+		cv->rsin[k] = (float)sin(a);
+	}
+
+	// transform each partition of each path of the impulse response, scaled by 1 / 2m to cancel
+	// out the scaling of irfft
+	float *x = cv->work; // 2m samples of time domain
+	float scale = 0.5f / m;
+	for (int path = 0; path < paths; path++){
+		const sf_sample_st *ir = path < 2 ? irL : irR;
+		int right = path & 1;
+		for (int p = 0; p < partitions; p++){
+			for (int i = 0; i < m * 2; i++){
+				int n = p * m + i;
+				x[i] = i < m && n < size ? (right ? ir[n].R : ir[n].L) * scale : 0.0f;
+			}
+			float *spec = &cv->ir[((size_t)path * partitions + p) * m * 2];
+			rfft(cv, x, spec, &spec[m]);
+		}
+	}
+	memset(x, 0, sizeof(float) * m * 2);
+
+	return cv;
+}
+
+void sf_convolve_free(sf_convolve cv){
+	sf_free(cv->bitrev);
+	sf_free(cv->data);
+	sf_free(cv);
+}
+
+// transform the last 2B samples of input, and use the spectra to calculate the next B samples of
+// output
+static void convolve_block(sf_convolve cv){
+	int m = cv->blocksize;
+	int P = cv->partitions;
+	size_t specsize = (size_t)m * 2;
+
+	// save the spectrum of each input channel into the delay line, then slide the input down
+	for (int c = 0; c < 2; c++){
+		float *x = &cv->inbuf[c * m * 2];
+		float *spec = &cv->fdl[((size_t)c * P + cv->fdlpos) * specsize];
+		rfft(cv, x, spec, &spec[m]);
+		memcpy(x, &x[m], sizeof(float) * m);
+	}
+
+	float *acc = cv->work;
+	float *y = &cv->work[m * 2];
+	for (int o = 0; o < 2; o++){
+		memset(acc, 0, sizeof(float) * specsize);
+		for (int p = 0, fp = cv->fdlpos; p < P; p++, fp = fp == 0 ? P - 1 : fp - 1){
+			const float *XL = &cv->fdl[(size_t)fp * specsize];
+			const float *XR = &cv->fdl[((size_t)P + fp) * specsize];
+			if (cv->paths == 2){
+				const float *H = &cv->ir[((size_t)o * P + p) * specsize];
+				mac(acc, o == 0 ? XL : XR, H, m);
+			}
+			else{
+				// paths are ordered L->L, L->R, R->L, R->R
+				const float *HL = &cv->ir[((size_t)o * P + p) * specsize];
+				const float *HR = &cv->ir[((size_t)(2 + o) * P + p) * specsize];
+				mac(acc, XL, HL, m);
+				mac(acc, XR, HR, m);
+			}
+		}
+		irfft(cv, acc, &acc[m], y);
+
+		// overlap-save: only the second half of the result is valid
+		for (int i = 0; i < m; i++)
+			cv->outbuf[i * 2 + o] = y[m + i];
+	}
+
+	cv->fdlpos = cv->fdlpos + 1 == P ? 0 : cv->fdlpos + 1;
+}
+
+void sf_convolve_process(sf_convolve cv, int size, sf_sample_st *input, sf_sample_st *output){
+	sf_denormal_st dn;
+	sf_denormal_begin(&dn);
+	int m = cv->blocksize;
+	float *inL = &cv->inbuf[m];
+	float *inR = &cv->inbuf[m * 3];
+	sf_sample_st *out = (sf_sample_st *)cv->outbuf;
+	int n = 0;
+	while (n < size){
+		// work up to the end of the current block
+		int len = m - cv->pos;
+		if (len > size - n)
+			len = size - n;
+		for (int i = 0; i < len; i++){
+			sf_sample_st s = input[n + i];
+			inL[cv->pos + i] = s.L;
+			inR[cv->pos + i] = s.R;
+			output[n + i] = out[cv->pos + i];
+		}
+		n += len;
+		cv->pos += len;
+		if (cv->pos == m){
+			convolve_block(cv);
+			cv->pos = 0;
+		}
+	}
+	sf_denormal_end(&dn);
+}
+
+bool sf_convolve_reverbimpulse(int rate, sf_reverb_preset preset, int size, sf_sample_st *irL,
+	sf_sample_st *irR){
+	if (size < 1)
+		return true;
+	sf_reverb_state_st rv;
+
+	// the reverb can process in place, so each impulse is rendered directly into the output
+	memset(irL, 0, sizeof(sf_sample_st) * size);
+	irL[0].L = 1.0f;
+	if (!sf_presetreverb(&rv, rate, preset))
+		return false;
+	sf_reverb_process(&rv, size, irL, irL);
+	sf_reverb_free(&rv);
+
+	memset(irR, 0, sizeof(sf_sample_st) * size);
+	irR[0].R = 1.0f;
+	if (!sf_presetreverb(&rv, rate, preset))
+		return false;
+	sf_reverb_process(&rv, size, irR, irR);
+	sf_reverb_free(&rv);
+	return true;
+}
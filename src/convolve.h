@@ -0,0 +1,94 @@
+//
+// sndfilter - Algorithms for sound filters, like reverb, lowpass, etc
+// by Sean Connelly (@velipso), https://sean.fun
+// Project Home: https://github.com/velipso/sndfilter
+// SPDX-License-Identifier: 0BSD
+//
+
+// convolution using uniformly partitioned overlap-save in the frequency domain
+
+#ifndef SNDFILTER_CONVOLVE__H
+#define SNDFILTER_CONVOLVE__H
+
+#include "snd.h"
+#include "reverb.h"
+
+// convolution applies an impulse response (the recording of a single click through a room, or
+// through another effect) to a sound, which reproduces the room or effect exactly, as long as it
+// doesn't change over time
+//
+// this API works by first creating an sf_convolve object from an impulse response, and then using
+// it to process a sample in chunks
+//
+// for example, say you want to replace a reverb preset with a convolution of its impulse response,
+// and process a stream in 128 samples per chunk:
+//
+//   int size = 4 * 48000; // 4 seconds of tail
+//   sf_sample_st *irL = sf_malloc(sizeof(sf_sample_st) * size);
+//   sf_sample_st *irR = sf_malloc(sizeof(sf_sample_st) * size);
+//   sf_convolve_reverbimpulse(48000, SF_REVERB_PRESET_LARGEHALL1, size, irL, irR);
+//
+//   sf_convolve cv = sf_convolve_new(1024, size, irL, irR);
+//
+//   for each 128 length sample:
+//     sf_convolve_process(cv, 128, input, output);
+//
+// the impulse response is split into partitions of `blocksize` samples, and each partition is
+// applied with an FFT; the output is delayed by exactly `blocksize` samples (the latency), and the
+// cost per sample is about the same for every block, and is proportional to:
+//
+//   paths * size / blocksize + log2(blocksize)
+//
+// so a larger blocksize is cheaper, at the price of more latency
+//
+// the impulse response is given as two stereo samples per time step:
+//   irL[n].L   response of the left output to an impulse on the left input
+//   irL[n].R   response of the right output to an impulse on the left input
+//   irR[n].L   response of the left output to an impulse on the right input
+//   irR[n].R   response of the right output to an impulse on the right input
+//
+// if irR is NULL, then each channel is convolved on its own (left with irL[n].L, right with
+// irL[n].R), which is how stereo impulse response WAVs are usually recorded, and costs half as
+// much
+
+// smallest and largest partition size; the size must be a power of 2 in this range
+#define SF_CONVOLVE_MINBLOCK     16
+#define SF_CONVOLVE_MAXBLOCK     65536
+
+typedef struct {
+	int blocksize;  // number of samples per partition, and the latency
+	int partitions; // number of partitions in the impulse response
+	int paths;      // 2 if each channel has its own impulse, 4 for full stereo
+	int pos;        // position inside of the current block
+	int fdlpos;     // partition of the newest input spectrum
+	float *costbl;  // complex FFT twiddles, for each stage
+	float *sintbl;
+	float *rcos;    // twiddles to split the complex FFT into the real FFT
+	float *rsin;
+	int *bitrev;    // bit reverse permutation for the complex FFT
+	float *ir;      // impulse spectra for each path and partition
+	float *fdl;     // input spectra for each channel and partition (frequency-domain delay line)
+	float *inbuf;   // last two blocks of input for each channel
+	float *outbuf;  // stereo output of the last block
+	float *work;    // scratch space for the FFTs
+	float *data;    // storage for all of the above
+} sf_convolve_st, *sf_convolve;
+
+// create a convolution from an impulse response that is `size` samples long
+// the blocksize must be a power of 2 between SF_CONVOLVE_MINBLOCK and SF_CONVOLVE_MAXBLOCK
+sf_convolve sf_convolve_new(int blocksize, int size, const sf_sample_st *irL,
+	const sf_sample_st *irR); // returns NULL for error
+void        sf_convolve_free(sf_convolve cv);
+
+// this function will process the input sound based on the state passed
+// the input and output buffers should be the same size
+void sf_convolve_process(sf_convolve cv, int size, sf_sample_st *input, sf_sample_st *output);
+
+// render the response of a reverb preset to an impulse on each input channel, `size` samples long;
+// the reverb's LFOs and noise keep the reverb from being perfectly time-invariant, so the
+// convolution sounds like a single snapshot of the preset rather than the moving original
+// (returns false for error)
+bool sf_convolve_reverbimpulse(int rate, sf_reverb_preset preset, int size, sf_sample_st *irL,
+	sf_sample_st *irR);
+
+#endif // SNDFILTER_CONVOLVE__H
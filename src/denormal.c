@@ -0,0 +1,50 @@
+//
+// sndfilter - Algorithms for sound filters, like reverb, lowpass, etc
+// by Sean Connelly (@velipso), https://sean.fun
+// Project Home: https://github.com/velipso/sndfilter
+// SPDX-License-Identifier: 0BSD
+//
+
+#include "denormal.h"
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+// initialize with protection turned on
+bool sf_denormal_ftz = true;
+
+void sf_denormal_begin(sf_denormal_st *dn){
+	dn->active = false;
+	if (!sf_denormal_ftz)
+		return;
+#if defined(__SSE__) || defined(_M_X64)
+	// MXCSR bit 15 is FTZ, and bit 6 is DAZ
+	unsigned int csr = _mm_getcsr();
+	dn->saved = csr;
+	if ((csr & 0x8040) != 0x8040){
+		_mm_setcsr(csr | 0x8040);
+		dn->active = true;
+	}
+#elif defined(__aarch64__)
+	// FPCR bit 24 is FZ, which flushes both the inputs and outputs
+	unsigned long fpcr;
+	__asm__ __volatile__("mrs %0, fpcr" : "=r"(fpcr));
+	dn->saved = fpcr;
+	if ((fpcr & (1ul << 24)) == 0){
+		__asm__ __volatile__("msr fpcr, %0" : : "r"(fpcr | (1ul << 24)));
+		dn->active = true;
+	}
+#endif
+}
+
+void sf_denormal_end(sf_denormal_st *dn){
+	if (!dn->active)
+		return;
+#if defined(__SSE__) || defined(_M_X64)
+	_mm_setcsr((unsigned int)dn->saved);
+#elif defined(__aarch64__)
+	__asm__ __volatile__("msr fpcr, %0" : : "r"(dn->saved));
+#endif
+	dn->active = false;
+}
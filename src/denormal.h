@@ -0,0 +1,50 @@
+//
+// sndfilter - Algorithms for sound filters, like reverb, lowpass, etc
+// by Sean Connelly (@velipso), https://sean.fun
+// Project Home: https://github.com/velipso/sndfilter
+// SPDX-License-Identifier: 0BSD
+//
+
+// denormal protection
+
+#ifndef SNDFILTER_DENORMAL__H
+#define SNDFILTER_DENORMAL__H
+
+#include <stdbool.h>
+
+// when a feedback loop (a reverb tail, or an IIR filter) decays towards silence, its values
+// eventually become denormal (smaller than about 1e-38), and on most CPUs math on denormal floats
+// is 10 to 100 times slower than normal, so silence after a sound can be much slower to process
+// than the sound itself
+//
+// the library protects itself in two ways:
+//
+//   1. every floating point process function turns on flush-to-zero (FTZ) and denormals-are-zero
+//      (DAZ) while it runs, and restores the caller's settings before returning
+//   2. the reverb's longest feedback loops add a tiny offset (SF_DENORMAL_OFFSET, which is -360dB),
+//      so they never decay into denormals, even on CPUs where FTZ/DAZ isn't available; its smaller
+//      filters can still decay into them, so without FTZ/DAZ a reverb tail is still slower
+//
+// FTZ/DAZ is supported on x86 with SSE, and on 64-bit ARM (where FTZ also covers the inputs)
+//
+// `sndfilter bench` times the tail of a reverb and a biquad after a second of noise, with and
+// without FTZ/DAZ, and fails if the protected tail is more than twice as slow as the noise
+
+// overwrite this global with false to leave the floating point settings alone while processing;
+// it's shared by the whole process (every thread, and every filter), and each process function
+// reads it when it starts, so set it once before processing starts instead of changing it while
+// another thread might be processing
+extern bool sf_denormal_ftz;
+
+#define SF_DENORMAL_OFFSET 1e-18f
+
+// process functions wrap their work with these, to turn on FTZ/DAZ and then restore the settings
+typedef struct {
+	unsigned long saved; // floating point control register before sf_denormal_begin
+	bool active;         // true if the register was changed
+} sf_denormal_st;
+
+void sf_denormal_begin(sf_denormal_st *dn);
+void sf_denormal_end(sf_denormal_st *dn);
+
+#endif // SNDFILTER_DENORMAL__H
@@ -0,0 +1,229 @@
+//
+// sndfilter - Algorithms for sound filters, like reverb, lowpass, etc
+// by Sean Connelly (@velipso), https://sean.fun
+// Project Home: https://github.com/velipso/sndfilter
+// SPDX-License-Identifier: 0BSD
+//
+
+#include "limiter.h"
+#include "denormal.h"
+#include "mem.h"
+#include <math.h>
+#include <string.h>
+
+// 4x oversampling interpolation filter from ITU-R BS.1770-4, annex 2, split into 4 phases of 12
+// taps
+static const float tpcoef[4][SF_LIMITER_TRUEPEAKTAPS] = {
+	{  0.0017089843750f,  0.0109863281250f, -0.0196533203125f,  0.0332031250000f,
+	  -0.0594482421875f,  0.1373291015625f,  0.9721679687500f, -0.1022949218750f,
+	   0.0476074218750f, -0.0266113281250f,  0.0148925781250f, -0.0083007812500f },
+	{ -0.0291748046875f,  0.0292968750000f, -0.0517578125000f,  0.0891113281250f,
+	  -0.1665039062500f,  0.4650878906250f,  0.7797851562500f, -0.2003173828125f,
+	   0.1015625000000f, -0.0582275390625f,  0.0330810546875f, -0.0189208984375f },
+	{ -0.0189208984375f,  0.0330810546875f, -0.0582275390625f,  0.1015625000000f,
+	  -0.2003173828125f,  0.7797851562500f,  0.4650878906250f, -0.1665039062500f,
+	   0.0891113281250f, -0.0517578125000f,  0.0292968750000f, -0.0291748046875f },
+	{ -0.0083007812500f,  0.0148925781250f, -0.0266113281250f,  0.0476074218750f,
+	  -0.1022949218750f,  0.9721679687500f,  0.1373291015625f, -0.0594482421875f,
+	   0.0332031250000f, -0.0196533203125f,  0.0109863281250f,  0.0017089843750f }
+};
+
+static inline float absf(float v){
+	return v < 0.0f ? -v : v;
+}
+
+sf_limiter sf_limiter_new(int rate, int channels, float ceiling, float lookahead, float release,
+	bool truepeak){
+	if (rate <= 0 || channels < 1 || channels > SF_SND_MAXCHANNELS)
+		return NULL;
+	if (lookahead < 0.0f)
+		lookahead = 0.0f;
+	else if (lookahead > 0.1f)
+		lookahead = 0.1f;
+
+	// the window covers the current sample plus the lookahead
+	int window = (int)(lookahead * rate) + 1;
+	int latency = window - 1 + (truepeak ? SF_LIMITER_TRUEPEAKDELAY : 0);
+
+	// every ring has the same power of 2 size, which must hold the window, the delayed samples, and
+	// the history for the true peak filter
+	int size = 1;
+	while (size < window || size <= latency || size < SF_LIMITER_TRUEPEAKTAPS)
+		size <<= 1;
+
+	sf_limiter lim = sf_malloc(sizeof(sf_limiter_st));
+	if (lim == NULL)
+		return NULL;
+	lim->dqtime = sf_malloc(sizeof(unsigned int) * size);
+	// delaybuf, gainbuf, dqpeak
+	size_t total = (size_t)size * channels + (size_t)size * 2;
+	lim->data = sf_malloc(sizeof(float) * total);
+	if (lim->dqtime == NULL || lim->data == NULL){
+		if (lim->dqtime)
+			sf_free(lim->dqtime);
+		if (lim->data)
+			sf_free(lim->data);
+		sf_free(lim);
+		return NULL;
+	}
+	memset(lim->data, 0, sizeof(float) * total);
+	memset(lim->dqtime, 0, sizeof(unsigned int) * size);
+
+	lim->channels    = channels;
+	lim->latency     = latency;
+	lim->window      = window;
+	lim->ceiling     = powf(10.0f, 0.05f * ceiling);
+	lim->releasecoef = release > 0.0f ? 1.0f - expf(-1.0f / (release * rate)) : 1.0f;
+	lim->truepeak    = truepeak;
+	lim->tplast      = 0.0f;
+	lim->gain        = 1.0f;
+	lim->gainsum     = window;
+	lim->time        = 0;
+	lim->mask        = size - 1;
+	lim->delaybuf    = lim->data;
+	lim->gainbuf     = &lim->delaybuf[size * channels];
+	lim->dqpeak      = &lim->gainbuf[size];
+	lim->dqhead      = 0;
+	lim->dqtail      = 0;
+	for (int i = 0; i < size; i++)
+		lim->gainbuf[i] = 1.0f;
+
+	return lim;
+}
+
+void sf_limiter_free(sf_limiter lim){
+	sf_free(lim->dqtime);
+	sf_free(lim->data);
+	sf_free(lim);
+}
+
+// largest absolute value of the four points in between the 6th and 7th newest samples, for every
+// channel
+static inline float truepeak(sf_limiter lim, int channels, unsigned int time){
+	const int taps = SF_LIMITER_TRUEPEAKTAPS;
+	int mask = lim->mask;
+	float peak = 0.0f;
+	for (int c = 0; c < channels; c++){
+		// newest sample first
+		float hist[SF_LIMITER_TRUEPEAKTAPS];
+		for (int k = 0; k < taps; k++)
+			hist[k] = lim->delaybuf[((time - k) & mask) * channels + c];
+		for (int p = 0; p < 4; p++){
+			float v = 0.0f;
+			for (int k = 0; k < taps; k++)
+				v += hist[k] * tpcoef[p][k];
+			v = absf(v);
+			if (v > peak)
+				peak = v;
+		}
+	}
+	return peak;
+}
+
+static void limiter_process(sf_limiter lim, int channels, int size, float *input, float *output){
+	sf_denormal_st dn;
+	sf_denormal_begin(&dn);
+
+	int mask = lim->mask;
+	int latency = lim->latency;
+	unsigned int window = lim->window;
+	float ceiling = lim->ceiling;
+	float releasecoef = lim->releasecoef;
+	float gain = lim->gain;
+	double gainsum = lim->gainsum;
+	unsigned int time = lim->time;
+	unsigned int dqhead = lim->dqhead;
+	unsigned int dqtail = lim->dqtail;
+	float *delaybuf = lim->delaybuf;
+	float *gainbuf = lim->gainbuf;
+	float *dqpeak = lim->dqpeak;
+	unsigned int *dqtime = lim->dqtime;
+
+	for (int i = 0; i < size; i++, time++){
+		// store the input in the delay line, and find its peak
+		float *in = &input[i * channels];
+		float *delayin = &delaybuf[(time & mask) * channels];
+		float peak = 0.0f;
+		for (int c = 0; c < channels; c++){
+			float v = in[c];
+			delayin[c] = v;
+			v = absf(v);
+			if (v > peak)
+				peak = v;
+		}
+
+		// with true peak detection, the peak is for the sample SF_LIMITER_TRUEPEAKDELAY back, and
+		// includes the points between it and both of its neighbors
+		if (lim->truepeak){
+			float *delayed = &delaybuf[((time - SF_LIMITER_TRUEPEAKDELAY) & mask) * channels];
+			peak = 0.0f;
+			for (int c = 0; c < channels; c++){
+				float v = absf(delayed[c]);
+				if (v > peak)
+					peak = v;
+			}
+			float tp = truepeak(lim, channels, time);
+			if (tp > peak)
+				peak = tp;
+			if (lim->tplast > peak)
+				peak = lim->tplast;
+			lim->tplast = tp;
+		}
+
+		// drop the head of the deque if it has left the window, then push the peak, dropping the
+		// smaller peaks before it (they can never be the maximum again)
+		while (dqhead != dqtail && time - dqtime[dqhead & mask] >= window)
+			dqhead++;
+		while (dqtail != dqhead && dqpeak[(dqtail - 1) & mask] <= peak)
+			dqtail--;
+		dqpeak[dqtail & mask] = peak;
+		dqtime[dqtail & mask] = time;
+		dqtail++;
+		float windowpeak = dqpeak[dqhead & mask];
+
+		// gain needed for the window, with release
+		float target = windowpeak > ceiling ? ceiling / windowpeak : 1.0f;
+		if (target < gain)
+			gain = target;
+		else
+			gain += (target - gain) * releasecoef;
+
+		// moving average of the gain over the window; the sum is recalculated once per trip around
+		// the ring so rounding errors can't build up
+		gainsum += gain - gainbuf[(time - window) & mask];
+		gainbuf[time & mask] = gain;
+		if ((time & mask) == (unsigned int)mask){
+			gainsum = 0.0;
+			for (unsigned int j = 0; j < window; j++)
+				gainsum += gainbuf[(time - j) & mask];
+		}
+		float g = (float)(gainsum / window);
+
+		// apply the gain to the delayed input
+		float *out = &output[i * channels];
+		float *delayout = &delaybuf[((time - latency) & mask) * channels];
+		for (int c = 0; c < channels; c++)
+			out[c] = delayout[c] * g;
+	}
+
+	lim->gain    = gain;
+	lim->gainsum = gainsum;
+	lim->time    = time;
+	lim->dqhead  = dqhead;
+	lim->dqtail  = dqtail;
+	sf_denormal_end(&dn);
+}
+
+bool sf_limiter_process(sf_limiter lim, int size, sf_sample_st *input, sf_sample_st *output){
+	if (lim->channels != 2)
+		return false;
+	limiter_process(lim, 2, size, (float *)input, (float *)output);
+	return true;
+}
+
+bool sf_limiter_processn(sf_limiter lim, int channels, int size, float *input, float *output){
+	if (channels != lim->channels)
+		return false;
+	limiter_process(lim, channels, size, input, output);
+	return true;
+}
@@ -0,0 +1,95 @@
+//
+// sndfilter - Algorithms for sound filters, like reverb, lowpass, etc
+// by Sean Connelly (@velipso), https://sean.fun
+// Project Home: https://github.com/velipso/sndfilter
+// SPDX-License-Identifier: 0BSD
+//
+
+// lookahead brickwall limiter
+
+#ifndef SNDFILTER_LIMITER__H
+#define SNDFILTER_LIMITER__H
+
+#include "snd.h"
+
+// a limiter guarantees that the output never goes above a ceiling, unlike the compressor, which
+// only reduces the level gradually and overshoots on fast transients
+//
+// this API works by first creating an sf_limiter object, and then using it to process a sample in
+// chunks:
+//
+//   sf_limiter lim = sf_limiter_new(48000, 2, -1.0f, 0.005f, 0.100f, true);
+//
+//   for each 128 length sample:
+//     sf_limiter_process(lim, 128, input, output);
+//
+//   sf_limiter_free(lim);
+//
+// like the compressor's predelay, the input is delayed (by lim->latency samples), so the gain can
+// already be lowered by the time a peak reaches the output; the gain is found by:
+//
+//   1. taking the peak of every channel for each sample
+//   2. finding the maximum peak over the lookahead window, using a monotonic deque, so the cost per
+//      sample doesn't depend on the length of the window
+//   3. converting that to the gain needed to stay under the ceiling, and letting the gain recover
+//      with the release time
+//   4. smoothing the gain with a moving average as long as the window, so the gain reaches its
+//      lowest point exactly when the peak is output, without a sudden step
+//
+// since every value averaged in step 4 is already low enough for the peak, the output of the
+// limiter stays under the ceiling (besides float rounding)
+//
+// with true peak detection, step 1 also checks four points in between each pair of samples, using
+// the 4x oversampling filter of ITU-R BS.1770 (48 taps), which catches most of the peaks that a DAC
+// would produce between samples; this adds SF_LIMITER_TRUEPEAKDELAY samples of latency
+//
+// like a BS.1770 meter, the filter can't see content near the Nyquist frequency very well;
+// material below 0.45 of the sample rate (about 20kHz at 44.1kHz) stays under the ceiling, but full
+// band noise can still overshoot by up to about 0.7dB
+
+#define SF_LIMITER_TRUEPEAKTAPS   12 // taps per phase of the true peak interpolation filter
+#define SF_LIMITER_TRUEPEAKDELAY  6
+
+typedef struct {
+	int channels;     // number of interleaved channels
+	int latency;      // samples of delay between the input and output
+	int window;       // samples in the lookahead window
+	float ceiling;    // linear ceiling
+	float releasecoef;
+	bool truepeak;
+	float tplast;     // peak between the previous pair of samples
+	float gain;       // gain after the release
+	double gainsum;   // sum of the gains in the moving average
+	unsigned int time; // number of samples processed
+	int mask;         // mask for all the rings below, which have a power of 2 size
+	float *delaybuf;  // delayed input, with `channels` values per sample
+	float *gainbuf;   // gains in the moving average
+	float *dqpeak;    // monotonic deque of peaks, decreasing from head to tail
+	unsigned int *dqtime; // time each peak was added
+	unsigned int dqhead;
+	unsigned int dqtail;
+	float *data;      // storage for all of the above
+} sf_limiter_st, *sf_limiter;
+
+// create a limiter
+sf_limiter sf_limiter_new(
+	int rate,        // input sample rate (samples per second)
+	int channels,    // number of channels (1 to SF_SND_MAXCHANNELS)
+	float ceiling,   // dB, maximum output level [-30 to 0]
+	float lookahead, // seconds, length of the lookahead [0 to 0.1]
+	float release,   // seconds, time for the gain to recover [0 to 1]
+	bool truepeak    // check for peaks in between samples
+); // returns NULL for error
+void sf_limiter_free(sf_limiter lim);
+
+// this function will process the input sound based on the state passed
+// the input and output buffers should be the same size, and the limiter must have 2 channels
+// (the process functions return false for error, such as a channel count that doesn't match the
+// limiter, and then leave the output alone)
+bool sf_limiter_process(sf_limiter lim, int size, sf_sample_st *input, sf_sample_st *output);
+
+// same as above, for an N-channel sound with interleaved samples (see sf_sndn_st); the channel
+// count must match the limiter
+bool sf_limiter_processn(sf_limiter lim, int channels, int size, float *input, float *output);
+
+#endif // SNDFILTER_LIMITER__H
@@ -10,10 +10,16 @@
 #include "wav.h"
 #include "biquad.h"
 #include "compressor.h"
+#include "multiband.h"
+#include "limiter.h"
 #include "reverb.h"
+#include "convolve.h"
+#include "mem.h"
+#include "denormal.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <time.h>
 
 static int printabout(){
 	printf(
@@ -30,12 +36,14 @@ static int printhelp(){
 	printf("\n"
 		"Usage:\n"
 		"  sndfilter input.wav output.wav <filter> <...>\n"
+		"  sndfilter bench\n"
 		"\n"
 		"Where:\n"
 		"  input.wav    Input WAV file to process\n"
 		"  output.wav   Output WAV file of filtered results\n"
 		"  <filter>     One of the available filters (see below)\n"
 		"  <...>        Additional parameters for the particular filter\n"
+		"  bench        Times the tails of a reverb and a biquad, to check denormal protection\n"
 		"\n"
 		"  Filters:\n"
 		"    lowpass     Passes low frequencies through and dampens high frequencies\n"
@@ -47,7 +55,10 @@ static int printhelp(){
 		"    lowshelf    Adds gain to lower frequencies\n"
 		"    highshelf   Adds gain to higher frequencies\n"
 		"    compressor  Dyanmic range compression, usually to make sounds louder\n"
+		"    multiband   Compression split into low, mid, and high bands\n"
+		"    limiter     Keeps the sound under a ceiling without clipping\n"
 		"    reverb      Reverberation\n"
+		"    convreverb  Reverberation by convolving with the impulse response of a reverb preset\n"
 		"\n"
 		"  Filter Details:\n"
 		"    lowpass <cutoff> <resonance>\n"
@@ -93,13 +104,30 @@ static int printhelp(){
 		"      attack     Seconds for the compression to kick in (0 to 1)\n"
 		"      release    Seconds for the compression to release (0 to 1)\n"
 		"\n"
+		"    multiband <low> <high> <pregain> <threshold> <knee> <ratio> <attack> <release>\n"
+		"      low        Frequency between the low and mid bands (Hz)\n"
+		"      high       Frequency between the mid and high bands (Hz)\n"
+		"      ...        Same as compressor, applied to each band\n"
+		"\n"
+		"    limiter <ceiling> <lookahead> <release> <truepeak>\n"
+		"      ceiling    Decibel level the output stays under (-30 to 0)\n"
+		"      lookahead  Seconds to look ahead for peaks (0 to 0.1)\n"
+		"      release    Seconds for the gain to recover (0 to 1)\n"
+		"      truepeak   1 to check for peaks between samples, 0 for only sample peaks\n"
+		"\n"
 		"    reverb <tail> <preset>\n"
 		"      tail       Seconds after input ends to allow reverb to continue\n"
 		"      preset     One of the presets below:\n"
 		"                   default, smallhall1, smallhall2, mediumhall1, mediumhall2,\n"
 		"                   largehall1, largehall2, smallroom1, smallroom2,\n"
 		"                   mediumroom1, mediumroom2, largeroom1, largeroom2, mediumer1,\n"
-		"                   mediumer2, platehigh, platelow, longreverb1, longreverb2\n");
+		"                   mediumer2, platehigh, platelow, longreverb1, longreverb2\n"
+		"\n"
+		"    convreverb <tail> <preset> <length> <blocksize>\n"
+		"      tail       Seconds after input ends to allow reverb to continue\n"
+		"      preset     One of the reverb presets above\n"
+		"      length     Seconds of the preset's impulse response to capture\n"
+		"      blocksize  Samples of latency, power of 2 (16 to 65536), larger is faster\n");
 	return 0;
 }
 
@@ -146,15 +174,85 @@ static inline int compressor(sf_snd input_snd, sf_compressor_state_st *state, co
 	}
 
 	// process the compressor in one sweep
-	sf_compressor_process(state, input_snd->size, input_snd->samples, output_snd->samples);
+	if (!sf_compressor_process(state, input_snd->size, input_snd->samples, output_snd->samples)){
+		sf_snd_free(input_snd);
+		sf_snd_free(output_snd);
+		fprintf(stderr, "Error: Failed to apply filter\n");
+		return 1;
+	}
+
+	bool res = sf_wavsave(output_snd, output);
+	sf_snd_free(input_snd);
+	sf_snd_free(output_snd);
+	if (!res){
+		fprintf(stderr, "Error: Failed to save WAV: %s\n", output);
+		return 1;
+	}
+	return 0;
+}
+
+static inline int multiband(sf_snd input_snd, float low, float high, float *comp,
+	const char *output){
+	float crossovers[2] = { low, high };
+	sf_multiband mb = sf_multiband_new(input_snd->rate, 3, crossovers, 1);
+	bool ok = mb != NULL;
+	for (int b = 0; ok && b < 3; b++){
+		sf_compressor_free(&mb->comp[b]);
+		ok = sf_simplecomp(&mb->comp[b], input_snd->rate, comp[0], comp[1], comp[2], comp[3],
+			comp[4], comp[5]);
+	}
+	sf_snd output_snd = ok ? sf_snd_new(input_snd->size, input_snd->rate, false) : NULL;
+	if (output_snd == NULL){
+		if (mb)
+			sf_multiband_free(mb);
+		sf_snd_free(input_snd);
+		fprintf(stderr, "Error: Failed to apply filter\n");
+		return 1;
+	}
+
+	// process the compressor in one sweep
+	sf_multiband_process(mb, input_snd->size, input_snd->samples, output_snd->samples);
 
-	// note that the compressor does not output one sample per input sample, because the compressor
-	// works in subchunks of 32 samples (this is defined via SF_COMPRESSOR_SPU in compressor.c)
-	//
-	// that means the output size will be floor(input_size / 32) * 32
+	bool res = sf_wavsave(output_snd, output);
+	sf_multiband_free(mb);
+	sf_snd_free(input_snd);
+	sf_snd_free(output_snd);
+	if (!res){
+		fprintf(stderr, "Error: Failed to save WAV: %s\n", output);
+		return 1;
+	}
+	return 0;
+}
+
+static inline int limiter(sf_snd input_snd, float ceiling, float lookahead, float release,
+	bool truepeak, const char *output){
+	sf_limiter lim = sf_limiter_new(input_snd->rate, 2, ceiling, lookahead, release, truepeak);
+
+	// the limiter delays the output by its latency, so process that much extra and skip it
+	int total = lim ? input_snd->size + lim->latency : 0;
+	sf_snd work_snd = lim ? sf_snd_new(total, input_snd->rate, true) : NULL;
+	sf_snd output_snd = lim ? sf_snd_new(input_snd->size, input_snd->rate, false) : NULL;
+	if (work_snd == NULL || output_snd == NULL){
+		if (lim)
+			sf_limiter_free(lim);
+		if (work_snd)
+			sf_snd_free(work_snd);
+		if (output_snd)
+			sf_snd_free(output_snd);
+		sf_snd_free(input_snd);
+		fprintf(stderr, "Error: Failed to apply filter\n");
+		return 1;
+	}
+
+	memcpy(work_snd->samples, input_snd->samples, sizeof(sf_sample_st) * input_snd->size);
+	sf_limiter_process(lim, total, work_snd->samples, work_snd->samples);
+	memcpy(output_snd->samples, &work_snd->samples[lim->latency],
+		sizeof(sf_sample_st) * output_snd->size);
 
 	bool res = sf_wavsave(output_snd, output);
+	sf_limiter_free(lim);
 	sf_snd_free(input_snd);
+	sf_snd_free(work_snd);
 	sf_snd_free(output_snd);
 	if (!res){
 		fprintf(stderr, "Error: Failed to save WAV: %s\n", output);
@@ -163,28 +261,34 @@ static inline int compressor(sf_snd input_snd, sf_compressor_state_st *state, co
 	return 0;
 }
 
+static inline bool getpreset(const char *preset, sf_reverb_preset *p){
+	if      (strcmp(preset, "default"    ) == 0) *p = SF_REVERB_PRESET_DEFAULT;
+	else if (strcmp(preset, "smallhall1" ) == 0) *p = SF_REVERB_PRESET_SMALLHALL1;
+	else if (strcmp(preset, "smallhall2" ) == 0) *p = SF_REVERB_PRESET_SMALLHALL2;
+	else if (strcmp(preset, "mediumhall1") == 0) *p = SF_REVERB_PRESET_MEDIUMHALL1;
+	else if (strcmp(preset, "mediumhall2") == 0) *p = SF_REVERB_PRESET_MEDIUMHALL2;
+	else if (strcmp(preset, "largehall1" ) == 0) *p = SF_REVERB_PRESET_LARGEHALL1;
+	else if (strcmp(preset, "largehall2" ) == 0) *p = SF_REVERB_PRESET_LARGEHALL2;
+	else if (strcmp(preset, "smallroom1" ) == 0) *p = SF_REVERB_PRESET_SMALLROOM1;
+	else if (strcmp(preset, "smallroom2" ) == 0) *p = SF_REVERB_PRESET_SMALLROOM2;
+	else if (strcmp(preset, "mediumroom1") == 0) *p = SF_REVERB_PRESET_MEDIUMROOM1;
+	else if (strcmp(preset, "mediumroom2") == 0) *p = SF_REVERB_PRESET_MEDIUMROOM2;
+	else if (strcmp(preset, "largeroom1" ) == 0) *p = SF_REVERB_PRESET_LARGEROOM1;
+	else if (strcmp(preset, "largeroom2" ) == 0) *p = SF_REVERB_PRESET_LARGEROOM2;
+	else if (strcmp(preset, "mediumer1"  ) == 0) *p = SF_REVERB_PRESET_MEDIUMER1;
+	else if (strcmp(preset, "mediumer2"  ) == 0) *p = SF_REVERB_PRESET_MEDIUMER2;
+	else if (strcmp(preset, "platehigh"  ) == 0) *p = SF_REVERB_PRESET_PLATEHIGH;
+	else if (strcmp(preset, "platelow"   ) == 0) *p = SF_REVERB_PRESET_PLATELOW;
+	else if (strcmp(preset, "longreverb1") == 0) *p = SF_REVERB_PRESET_LONGREVERB1;
+	else if (strcmp(preset, "longreverb2") == 0) *p = SF_REVERB_PRESET_LONGREVERB2;
+	else
+		return false;
+	return true;
+}
+
 static inline int reverb(sf_snd input_snd, float tail, const char *preset, const char *output){
 	sf_reverb_preset p;
-	if      (strcmp(preset, "default"    ) == 0) p = SF_REVERB_PRESET_DEFAULT;
-	else if (strcmp(preset, "smallhall1" ) == 0) p = SF_REVERB_PRESET_SMALLHALL1;
-	else if (strcmp(preset, "smallhall2" ) == 0) p = SF_REVERB_PRESET_SMALLHALL2;
-	else if (strcmp(preset, "mediumhall1") == 0) p = SF_REVERB_PRESET_MEDIUMHALL1;
-	else if (strcmp(preset, "mediumhall2") == 0) p = SF_REVERB_PRESET_MEDIUMHALL2;
-	else if (strcmp(preset, "largehall1" ) == 0) p = SF_REVERB_PRESET_LARGEHALL1;
-	else if (strcmp(preset, "largehall2" ) == 0) p = SF_REVERB_PRESET_LARGEHALL2;
-	else if (strcmp(preset, "smallroom1" ) == 0) p = SF_REVERB_PRESET_SMALLROOM1;
-	else if (strcmp(preset, "smallroom2" ) == 0) p = SF_REVERB_PRESET_SMALLROOM2;
-	else if (strcmp(preset, "mediumroom1") == 0) p = SF_REVERB_PRESET_MEDIUMROOM1;
-	else if (strcmp(preset, "mediumroom2") == 0) p = SF_REVERB_PRESET_MEDIUMROOM2;
-	else if (strcmp(preset, "largeroom1" ) == 0) p = SF_REVERB_PRESET_LARGEROOM1;
-	else if (strcmp(preset, "largeroom2" ) == 0) p = SF_REVERB_PRESET_LARGEROOM2;
-	else if (strcmp(preset, "mediumer1"  ) == 0) p = SF_REVERB_PRESET_MEDIUMER1;
-	else if (strcmp(preset, "mediumer2"  ) == 0) p = SF_REVERB_PRESET_MEDIUMER2;
-	else if (strcmp(preset, "platehigh"  ) == 0) p = SF_REVERB_PRESET_PLATEHIGH;
-	else if (strcmp(preset, "platelow"   ) == 0) p = SF_REVERB_PRESET_PLATELOW;
-	else if (strcmp(preset, "longreverb1") == 0) p = SF_REVERB_PRESET_LONGREVERB1;
-	else if (strcmp(preset, "longreverb2") == 0) p = SF_REVERB_PRESET_LONGREVERB2;
-	else{
+	if (!getpreset(preset, &p)){
 		fprintf(stderr, "Error: Invalid reverb preset: %s\n", preset);
 		return 1;
 	}
@@ -199,7 +303,12 @@ static inline int reverb(sf_snd input_snd, float tail, const char *preset, const
 
 	// process the reverb in one sweep
 	sf_reverb_state_st rv;
-	sf_presetreverb(&rv, input_snd->rate, p);
+	if (!sf_presetreverb(&rv, input_snd->rate, p)){
+		sf_snd_free(input_snd);
+		sf_snd_free(output_snd);
+		fprintf(stderr, "Error: Failed to apply filter\n");
+		return 1;
+	}
 	sf_reverb_process(&rv, input_snd->size, input_snd->samples, output_snd->samples);
 
 	// append the tail
@@ -219,6 +328,7 @@ static inline int reverb(sf_snd input_snd, float tail, const char *preset, const
 			}
 		}
 	}
+	sf_reverb_free(&rv);
 
 	bool res = sf_wavsave(output_snd, output);
 	sf_snd_free(input_snd);
@@ -230,7 +340,156 @@ static inline int reverb(sf_snd input_snd, float tail, const char *preset, const
 	return 0;
 }
 
+static inline int convreverb(sf_snd input_snd, float tail, const char *preset, float length,
+	int blocksize, const char *output){
+	sf_reverb_preset p;
+	if (!getpreset(preset, &p)){
+		fprintf(stderr, "Error: Invalid reverb preset: %s\n", preset);
+		return 1;
+	}
+
+	// capture the impulse response of the preset, and build the convolution from it
+	int irsize = length * input_snd->rate;
+	if (irsize < 1)
+		irsize = 1;
+	sf_sample_st *irL = sf_malloc(sizeof(sf_sample_st) * irsize);
+	sf_sample_st *irR = sf_malloc(sizeof(sf_sample_st) * irsize);
+	sf_convolve cv = NULL;
+	if (irL && irR && sf_convolve_reverbimpulse(input_snd->rate, p, irsize, irL, irR))
+		cv = sf_convolve_new(blocksize, irsize, irL, irR);
+	if (irL)
+		sf_free(irL);
+	if (irR)
+		sf_free(irR);
+
+	// the convolution delays the output by the blocksize, so process that much extra and skip it
+	int tailsmp = tail * input_snd->rate;
+	int total = input_snd->size + tailsmp + blocksize;
+	sf_snd work_snd = cv ? sf_snd_new(total, input_snd->rate, true) : NULL;
+	sf_snd output_snd = cv ? sf_snd_new(input_snd->size + tailsmp, input_snd->rate, false) : NULL;
+	if (work_snd == NULL || output_snd == NULL){
+		if (cv)
+			sf_convolve_free(cv);
+		if (work_snd)
+			sf_snd_free(work_snd);
+		if (output_snd)
+			sf_snd_free(output_snd);
+		sf_snd_free(input_snd);
+		fprintf(stderr, "Error: Failed to apply filter\n");
+		return 1;
+	}
+
+	memcpy(work_snd->samples, input_snd->samples, sizeof(sf_sample_st) * input_snd->size);
+	sf_convolve_process(cv, total, work_snd->samples, work_snd->samples);
+	memcpy(output_snd->samples, &work_snd->samples[blocksize],
+		sizeof(sf_sample_st) * output_snd->size);
+
+	bool res = sf_wavsave(output_snd, output);
+	sf_convolve_free(cv);
+	sf_snd_free(input_snd);
+	sf_snd_free(work_snd);
+	sf_snd_free(output_snd);
+	if (!res){
+		fprintf(stderr, "Error: Failed to save WAV: %s\n", output);
+		return 1;
+	}
+	return 0;
+}
+
+static double benchnow(){
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// feed a second of noise followed by silence through a filter, and time each second of audio; the
+// fastest of a few runs is kept for each second, and the result is the slowest second of the tail
+// divided by the second of noise (returns a negative value for error)
+#define BENCH_RATE     48000
+#define BENCH_SECONDS  12
+#define BENCH_RUNS     3
+static double benchtail(bool isreverb, bool ftz){
+	sf_sample_st *buf = sf_malloc(sizeof(sf_sample_st) * BENCH_RATE);
+	if (buf == NULL)
+		return -1;
+	double best[BENCH_SECONDS];
+	for (int s = 0; s < BENCH_SECONDS; s++)
+		best[s] = 1e9;
+	sf_denormal_ftz = ftz;
+	for (int run = 0; run < BENCH_RUNS; run++){
+		sf_reverb_state_st rv;
+		sf_biquad_state_st bq;
+		if (isreverb){
+			if (!sf_presetreverb(&rv, BENCH_RATE, SF_REVERB_PRESET_DEFAULT)){
+				sf_free(buf);
+				return -1;
+			}
+		}
+		else
+			sf_lowpass(&bq, BENCH_RATE, 1000.0f, 3.0f);
+		for (int s = 0; s < BENCH_SECONDS; s++){
+			if (s == 0){
+				unsigned int seed = 1;
+				for (int i = 0; i < BENCH_RATE; i++){
+					seed = seed * 1103515245u + 12345u;
+					buf[i].L = (float)(seed >> 8) / (1 << 24) - 0.5f;
+					seed = seed * 1103515245u + 12345u;
+					buf[i].R = (float)(seed >> 8) / (1 << 24) - 0.5f;
+				}
+			}
+			else
+				memset(buf, 0, sizeof(sf_sample_st) * BENCH_RATE);
+			double t = benchnow();
+			if (isreverb)
+				sf_reverb_process(&rv, BENCH_RATE, buf, buf);
+			else
+				sf_biquad_process(&bq, BENCH_RATE, buf, buf);
+			t = benchnow() - t;
+			if (t < best[s])
+				best[s] = t;
+		}
+		if (isreverb)
+			sf_reverb_free(&rv);
+	}
+	sf_denormal_ftz = true;
+	sf_free(buf);
+
+	double slowest = 0;
+	for (int s = 1; s < BENCH_SECONDS; s++){
+		if (best[s] > slowest)
+			slowest = best[s];
+	}
+	printf("  %-8s %-9s noise %8.3fms, slowest second of silence %8.3fms, ratio %6.2f\n",
+		isreverb ? "reverb" : "biquad", ftz ? "FTZ on" : "FTZ off", best[0] * 1000.0,
+		slowest * 1000.0, slowest / best[0]);
+	return slowest / best[0];
+}
+
+// with the denormal protection on, the tail shouldn't be much slower than the noise; the
+// unprotected runs are only printed for comparison
+static int bench(){
+	printf("Time to process a second of noise, and each of %d seconds of silence after it "
+		"(%dHz):\n", BENCH_SECONDS - 1, BENCH_RATE);
+	bool ok = true;
+	for (int i = 0; i < 2; i++){
+		double ratio = benchtail(i == 0, true);
+		if (ratio < 0 || benchtail(i == 0, false) < 0){
+			fprintf(stderr, "Error: Failed to initialize filter\n");
+			return 1;
+		}
+		if (ratio > 2.0)
+			ok = false;
+	}
+	if (!ok){
+		fprintf(stderr, "Error: The tail is more than twice as slow as the noise\n");
+		return 1;
+	}
+	return 0;
+}
+
 int main(int argc, char **argv){
+	if (argc == 2 && strcmp(argv[1], "bench") == 0)
+		return bench();
 	if (argc < 4)
 		return printhelp();
 
@@ -244,7 +503,7 @@ int main(int argc, char **argv){
 		return 1;
 	}
 
-	float params[6];
+	float params[8];
 	sf_biquad_state_st bq_state;
 	if (strcmp(filter, "lowpass") == 0){
 		if (!getargs(argc, argv, 2, params))
@@ -298,15 +557,36 @@ int main(int argc, char **argv){
 		if (!getargs(argc, argv, 6, params))
 			return badargs(filter);
 		sf_compressor_state_st cm_state;
-		sf_simplecomp(&cm_state, input_snd->rate, params[0], params[1], params[2], params[3],
-			params[4], params[5]);
-		return compressor(input_snd, &cm_state, output);
+		if (!sf_simplecomp(&cm_state, input_snd->rate, params[0], params[1], params[2], params[3],
+			params[4], params[5])){
+			sf_snd_free(input_snd);
+			fprintf(stderr, "Error: Failed to apply filter\n");
+			return 1;
+		}
+		int res = compressor(input_snd, &cm_state, output);
+		sf_compressor_free(&cm_state);
+		return res;
+	}
+	else if (strcmp(filter, "multiband") == 0){
+		if (!getargs(argc, argv, 8, params))
+			return badargs(filter);
+		return multiband(input_snd, params[0], params[1], &params[2], output);
+	}
+	else if (strcmp(filter, "limiter") == 0){
+		if (!getargs(argc, argv, 4, params))
+			return badargs(filter);
+		return limiter(input_snd, params[0], params[1], params[2], params[3] != 0, output);
 	}
 	else if (strcmp(filter, "reverb") == 0){
 		if (argc < 6 || !getargs(argc, argv, 1, params))
 			return badargs(filter);
 		return reverb(input_snd, params[0], argv[5], output);
 	}
+	else if (strcmp(filter, "convreverb") == 0){
+		if (argc < 8 || !getargs(argc, argv, 1, params))
+			return badargs(filter);
+		return convreverb(input_snd, params[0], argv[5], atof(argv[6]), atoi(argv[7]), output);
+	}
 
 	printhelp();
 	fprintf(stderr, "Error: Bad filter \"%s\"\n", filter);
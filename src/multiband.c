@@ -0,0 +1,245 @@
+//
+// sndfilter - Algorithms for sound filters, like reverb, lowpass, etc
+// by Sean Connelly (@velipso), https://sean.fun
+// Project Home: https://github.com/velipso/sndfilter
+// SPDX-License-Identifier: 0BSD
+//
+
+#include "multiband.h"
+#include "denormal.h"
+#include "mem.h"
+#include <string.h>
+
+#ifndef SF_MULTIBAND_NOTHREADS
+#include <pthread.h>
+#endif
+
+// Butterworth resonance (Q = 1/sqrt(2)), in dB for sf_lowpass and sf_highpass
+#define BUTTERWORTH_DB  -3.0103000f
+#define BUTTERWORTH_Q   0.70710678f
+
+#ifndef SF_MULTIBAND_NOTHREADS
+// worker threads wait for a block, then take bands to compress until none are left; the calling
+// thread takes bands too, and then waits for the workers to finish theirs
+typedef struct {
+	sf_multiband mb;
+	pthread_mutex_t lock;
+	pthread_cond_t wake;      // signaled when there's a new block
+	pthread_cond_t done;      // signaled when every band of the block is finished
+	pthread_t threads[SF_MULTIBAND_MAXBANDS];
+	int workers;              // number of threads created
+	unsigned int generation;  // incremented for each block
+	int len;                  // samples in the current block
+	int next;                 // next band to compress
+	int finished;             // number of bands compressed
+	bool quit;
+} pool_st;
+
+// called with the lock held
+static void pool_compress(pool_st *pool){
+	sf_multiband mb = pool->mb;
+	while (pool->next < mb->bands){
+		int b = pool->next++;
+		pthread_mutex_unlock(&pool->lock);
+		sf_sample_st *buf = &mb->bandbuf[b * mb->blocksize];
+		sf_compressor_process(&mb->comp[b], pool->len, buf, buf);
+		pthread_mutex_lock(&pool->lock);
+		pool->finished++;
+		if (pool->finished == mb->bands)
+			pthread_cond_signal(&pool->done);
+	}
+}
+
+static void *pool_worker(void *arg){
+	pool_st *pool = arg;
+	unsigned int seen = 0;
+	pthread_mutex_lock(&pool->lock);
+	while (true){
+		while (!pool->quit && pool->generation == seen)
+			pthread_cond_wait(&pool->wake, &pool->lock);
+		if (pool->quit)
+			break;
+		seen = pool->generation;
+		pool_compress(pool);
+	}
+	pthread_mutex_unlock(&pool->lock);
+	return NULL;
+}
+
+static void pool_free(pool_st *pool){
+	pthread_mutex_lock(&pool->lock);
+	pool->quit = true;
+	pthread_cond_broadcast(&pool->wake);
+	pthread_mutex_unlock(&pool->lock);
+	for (int i = 0; i < pool->workers; i++)
+		pthread_join(pool->threads[i], NULL);
+	pthread_cond_destroy(&pool->done);
+	pthread_cond_destroy(&pool->wake);
+	pthread_mutex_destroy(&pool->lock);
+	sf_free(pool);
+}
+
+static pool_st *pool_new(sf_multiband mb, int workers){
+	pool_st *pool = sf_malloc(sizeof(pool_st));
+	if (pool == NULL)
+		return NULL;
+	memset(pool, 0, sizeof(pool_st));
+	pool->mb = mb;
+	if (pthread_mutex_init(&pool->lock, NULL) != 0){
+		sf_free(pool);
+		return NULL;
+	}
+	if (pthread_cond_init(&pool->wake, NULL) != 0){
+		pthread_mutex_destroy(&pool->lock);
+		sf_free(pool);
+		return NULL;
+	}
+	if (pthread_cond_init(&pool->done, NULL) != 0){
+		pthread_cond_destroy(&pool->wake);
+		pthread_mutex_destroy(&pool->lock);
+		sf_free(pool);
+		return NULL;
+	}
+	for (int i = 0; i < workers; i++){
+		if (pthread_create(&pool->threads[i], NULL, pool_worker, pool) != 0){
+			pool_free(pool);
+			return NULL;
+		}
+		pool->workers++;
+	}
+	return pool;
+}
+
+static void pool_run(pool_st *pool, int len){
+	pthread_mutex_lock(&pool->lock);
+	pool->len = len;
+	pool->next = 0;
+	pool->finished = 0;
+	pool->generation++;
+	pthread_cond_broadcast(&pool->wake);
+	pool_compress(pool);
+	while (pool->finished < pool->mb->bands)
+		pthread_cond_wait(&pool->done, &pool->lock);
+	pthread_mutex_unlock(&pool->lock);
+}
+#endif
+
+sf_multiband sf_multiband_new(int rate, int bands, const float *crossovers, int threads){
+	if (rate <= 0 || bands < 1 || bands > SF_MULTIBAND_MAXBANDS || threads < 1)
+		return NULL;
+	for (int i = 0; i < bands - 1; i++){
+		if (crossovers[i] <= 0.0f || crossovers[i] >= rate * 0.5f ||
+			(i > 0 && crossovers[i] <= crossovers[i - 1]))
+			return NULL;
+	}
+	if (threads > bands)
+		threads = bands;
+#ifdef SF_MULTIBAND_NOTHREADS
+	threads = 1;
+#endif
+
+	sf_multiband mb = sf_malloc(sizeof(sf_multiband_st));
+	if (mb == NULL)
+		return NULL;
+	memset(mb, 0, sizeof(sf_multiband_st));
+	mb->rate      = rate;
+	mb->bands     = bands;
+	mb->threads   = threads;
+	mb->blocksize = threads > 1 ? SF_MULTIBAND_THREADBLOCK : SF_MULTIBAND_BLOCK;
+	for (int i = 0; i < bands - 1; i++){
+		float f = crossovers[i];
+		mb->crossovers[i] = f;
+		sf_lowpass (&mb->lowpass [i][0], rate, f, BUTTERWORTH_DB);
+		sf_lowpass (&mb->lowpass [i][1], rate, f, BUTTERWORTH_DB);
+		sf_highpass(&mb->highpass[i][0], rate, f, BUTTERWORTH_DB);
+		sf_highpass(&mb->highpass[i][1], rate, f, BUTTERWORTH_DB);
+		// the bands below this crossover go through its allpass
+		for (int b = 0; b < i; b++)
+			sf_allpass(&mb->allpass[b][i], rate, f, BUTTERWORTH_Q);
+	}
+
+	int compsready = 0;
+	for (; compsready < bands; compsready++){
+		if (!sf_defaultcomp(&mb->comp[compsready], rate))
+			break;
+	}
+	mb->bandbuf = sf_malloc(sizeof(sf_sample_st) * mb->blocksize * bands);
+#ifndef SF_MULTIBAND_NOTHREADS
+	if (threads > 1 && compsready == bands && mb->bandbuf)
+		mb->pool = pool_new(mb, threads - 1);
+#endif
+	if (compsready < bands || mb->bandbuf == NULL || (threads > 1 && mb->pool == NULL)){
+		for (int b = 0; b < compsready; b++)
+			sf_compressor_free(&mb->comp[b]);
+		if (mb->bandbuf)
+			sf_free(mb->bandbuf);
+		sf_free(mb);
+		return NULL;
+	}
+	return mb;
+}
+
+void sf_multiband_free(sf_multiband mb){
+#ifndef SF_MULTIBAND_NOTHREADS
+	if (mb->pool)
+		pool_free(mb->pool);
+#endif
+	for (int b = 0; b < mb->bands; b++)
+		sf_compressor_free(&mb->comp[b]);
+	sf_free(mb->bandbuf);
+	sf_free(mb);
+}
+
+// split a block into every band; each filter runs over the whole block with sf_biquad_process
+// (which uses SIMD for the two channels), while the block is small enough to stay in the L1 cache
+static void split(sf_multiband mb, int len, sf_sample_st *input){
+	int xovers = mb->bands - 1;
+	int blocksize = mb->blocksize;
+	sf_sample_st *rest = &mb->bandbuf[xovers * blocksize];
+	if (rest != input)
+		memcpy(rest, input, sizeof(sf_sample_st) * len);
+	for (int i = 0; i < xovers; i++){
+		sf_sample_st *lo = &mb->bandbuf[i * blocksize];
+		sf_biquad_process(&mb->lowpass[i][0], len, rest, lo);
+		sf_biquad_process(&mb->lowpass[i][1], len, lo, lo);
+		sf_biquad_process(&mb->highpass[i][0], len, rest, rest);
+		sf_biquad_process(&mb->highpass[i][1], len, rest, rest);
+		for (int j = i + 1; j < xovers; j++)
+			sf_biquad_process(&mb->allpass[i][j], len, lo, lo);
+	}
+}
+
+void sf_multiband_process(sf_multiband mb, int size, sf_sample_st *input, sf_sample_st *output){
+	sf_denormal_st dn;
+	sf_denormal_begin(&dn);
+	int bands = mb->bands;
+	int blocksize = mb->blocksize;
+	for (int pos = 0; pos < size; pos += blocksize){
+		int len = size - pos < blocksize ? size - pos : blocksize;
+		split(mb, len, &input[pos]);
+
+		// compress each band in place
+#ifndef SF_MULTIBAND_NOTHREADS
+		if (mb->pool)
+			pool_run(mb->pool, len);
+		else
+#endif
+		{
+			for (int b = 0; b < bands; b++){
+				sf_sample_st *buf = &mb->bandbuf[b * blocksize];
+				sf_compressor_process(&mb->comp[b], len, buf, buf);
+			}
+		}
+
+		// add the bands back together
+		for (int n = 0; n < len; n++){
+			sf_sample_st sum = mb->bandbuf[n];
+			for (int b = 1; b < bands; b++){
+				sum.L += mb->bandbuf[b * blocksize + n].L;
+				sum.R += mb->bandbuf[b * blocksize + n].R;
+			}
+			output[pos + n] = sum;
+		}
+	}
+	sf_denormal_end(&dn);
+}
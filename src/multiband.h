@@ -0,0 +1,88 @@
+//
+// sndfilter - Algorithms for sound filters, like reverb, lowpass, etc
+// by Sean Connelly (@velipso), https://sean.fun
+// Project Home: https://github.com/velipso/sndfilter
+// SPDX-License-Identifier: 0BSD
+//
+
+// multiband compressor
+
+#ifndef SNDFILTER_MULTIBAND__H
+#define SNDFILTER_MULTIBAND__H
+
+#include "snd.h"
+#include "biquad.h"
+#include "compressor.h"
+
+// a multiband compressor splits the sound into frequency bands, compresses each band with its own
+// compressor, and adds the bands back together, so a loud bass note doesn't pull down the level of
+// the vocals (for example)
+//
+// this API works by first creating an sf_multiband object, then setting up the compressor of each
+// band, and then using it to process a sample in chunks:
+//
+//   float crossovers[] = { 200, 2000 };
+//   sf_multiband mb = sf_multiband_new(48000, 3, crossovers, 1);
+//
+//   for each band b:
+//     sf_compressor_free(&mb->comp[b]);
+//     sf_simplecomp(&mb->comp[b], 48000, pregain[b], threshold[b], 30, ratio[b], 0.003f, 0.250f);
+//
+//   for each 128 length sample:
+//     sf_multiband_process(mb, 128, input, output);
+//
+//   sf_multiband_free(mb);
+//
+// the compressors start out with sf_defaultcomp, and are freed by sf_multiband_free; since each
+// band is delayed by its compressor's predelay, every band should use the same predelay
+// (sf_simplecomp and sf_defaultcomp all use the same one)
+//
+// the bands are split with Linkwitz-Riley crossovers (LR4, two Butterworth biquads in series for
+// each side), where the lowpass and highpass of a crossover add up to an allpass filter; each band
+// below a crossover also goes through that allpass, so when no band is compressed the output has
+// the same level as the input at every frequency (only the phase is changed)
+//
+// instead of running each filter and compressor over the whole sound, the sound is split into
+// blocks of SF_MULTIBAND_BLOCK samples, and every filter and compressor runs over a block before
+// moving to the next, so the bands stay in the L1 cache the whole time
+//
+// for large offline renders, the compressors of each band can run on separate threads, by passing
+// more than 1 thread to sf_multiband_new; the work is handed out in blocks of
+// SF_MULTIBAND_THREADBLOCK samples, and the output is identical to running on a single thread
+//
+// threads are created with pthreads, unless SF_MULTIBAND_NOTHREADS is defined when compiling
+// multiband.c, in which case everything runs on the calling thread
+
+#define SF_MULTIBAND_MAXBANDS    5
+#define SF_MULTIBAND_BLOCK       256
+#define SF_MULTIBAND_THREADBLOCK 4096
+
+typedef struct {
+	int rate;
+	int bands;     // number of bands (1 to SF_MULTIBAND_MAXBANDS)
+	int threads;   // number of threads processing the bands (including the calling thread)
+	int blocksize; // samples per band in bandbuf
+	float crossovers[SF_MULTIBAND_MAXBANDS - 1]; // Hz, increasing
+	sf_biquad_state_st lowpass[SF_MULTIBAND_MAXBANDS - 1][2]; // crossover filters
+	sf_biquad_state_st highpass[SF_MULTIBAND_MAXBANDS - 1][2];
+	// allpass[band][xover], keeps the phase of each band in line with the others
+	sf_biquad_state_st allpass[SF_MULTIBAND_MAXBANDS - 1][SF_MULTIBAND_MAXBANDS - 1];
+	sf_compressor_state_st comp[SF_MULTIBAND_MAXBANDS]; // compressor for each band
+	sf_sample_st *bandbuf; // blocksize samples for each band
+	void *pool;            // worker threads, or NULL
+} sf_multiband_st, *sf_multiband;
+
+// create a multiband compressor
+sf_multiband sf_multiband_new(
+	int rate,                // input sample rate (samples per second)
+	int bands,               // number of bands [1 to SF_MULTIBAND_MAXBANDS]
+	const float *crossovers, // Hz, bands - 1 increasing frequencies between the bands
+	int threads              // number of threads to use [1 to bands], 1 for no worker threads
+); // returns NULL for error
+void sf_multiband_free(sf_multiband mb);
+
+// this function will process the input sound based on the state passed
+// the input and output buffers should be the same size, and can be the same buffer
+void sf_multiband_process(sf_multiband mb, int size, sf_sample_st *input, sf_sample_st *output);
+
+#endif // SNDFILTER_MULTIBAND__H
@@ -6,11 +6,17 @@
 //
 
 #include "reverb.h"
+#include "denormal.h"
+#include "mem.h"
 #include <math.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <string.h>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 // utility functions
 static inline float db2lin(float db){ // dB to linear
 	return powf(10.0f, 0.05f * db);
@@ -67,41 +73,37 @@ static inline float randfloat(){
 
 // components are in the basic format of `<component>_make` to initialize a structure and
 // `<component>_step` to perform a single step with the component
+//
+// the `_make` functions only set the sizes of the buffers; once every component is made, the
+// buffers are taken from one allocation by reverb_layout (below)
 
 //
 // delay
 //
+// every ring below has a power of 2 capacity that's at least as long as the line, so positions can
+// wrap with a mask; reading `size` values behind the write position gives the same result as a
+// ring that's exactly `size` long
+static inline int ring_mask(int size){
+	int cap = 1;
+	while (cap < size)
+		cap <<= 1;
+	return cap - 1;
+}
+
 static inline void delay_make(sf_rv_delay_st *delay, int size){
 	delay->pos = 0;
-	delay->size = clampi(size, 1, SF_REVERB_DS);
-	memset(delay->buf, 0, sizeof(float) * delay->size);
+	delay->size = size < 1 ? 1 : size;
+	delay->mask = ring_mask(delay->size);
+	delay->buf = NULL;
 }
 
 static inline float delay_step(sf_rv_delay_st *delay, float v){
-	float out = delay->buf[delay->pos];
+	float out = delay->buf[(delay->pos - delay->size) & delay->mask];
 	delay->buf[delay->pos] = v;
-	delay->pos = (delay->pos + 1) % delay->size;
+	delay->pos = (delay->pos + 1) & delay->mask;
 	return out;
 }
 
-// delay_get(d, 1) returns the last written value
-// delay_get(d, 2) returns the second-last written value
-// ..etc
-static inline float delay_get(sf_rv_delay_st *delay, int offset){
-	if (offset > delay->size)
-		return delay->buf[delay->pos];
-	else if (offset <= 0)
-		offset = 1;
-	int pos = delay->pos - offset;
-	if (pos < 0)
-		pos += delay->size;
-	return delay->buf[pos];
-}
-
-static inline float delay_getlast(sf_rv_delay_st *delay){
-	return delay->buf[delay->pos];
-}
-
 //
 // iir1
 //
@@ -128,7 +130,7 @@ static inline void iir1_makeHPF(sf_rv_iir1_st *iir1, int rate, float freq){
 
 static inline float iir1_step(sf_rv_iir1_st *iir1, float v){
 	float out = v * iir1->b1 + iir1->y1;
-	iir1->y1 = out * iir1->a2 + v * iir1->b2;
+	iir1->y1 = out * iir1->a2 + v * iir1->b2 + SF_DENORMAL_OFFSET;
 	return out;
 }
 
@@ -237,6 +239,9 @@ static inline void earlyref_make(sf_rv_earlyref_st *earlyref, int rate, float fa
 	}
 	delay_make(&earlyref->delayPWL, earlyref->delaytblL[17] + 10);
 	delay_make(&earlyref->delayPWR, earlyref->delaytblR[17] + 10);
+	// the tap lines are written a block at a time, before the taps are read (see earlyref_process)
+	earlyref->delayPWL.mask = ring_mask(earlyref->delayPWL.size + SF_REVERB_BLOCK);
+	earlyref->delayPWR.mask = ring_mask(earlyref->delayPWR.size + SF_REVERB_BLOCK);
 
 	iir1_makeLPF(&earlyref->lpfL, rate, 20000.0f);
 	earlyref->lpfR = earlyref->lpfL;
@@ -245,36 +250,253 @@ static inline void earlyref_make(sf_rv_earlyref_st *earlyref, int rate, float fa
 	earlyref->hpfR = earlyref->hpfL;
 }
 
-static inline sf_sample_st earlyref_step(sf_rv_earlyref_st *earlyref, sf_sample_st input){
-	static const sf_sample_st gaintbl[18] = {
-		{ 0.841f, 0.842f }, { 0.504f, 0.506f }, { 0.491f, 0.489f }, { 0.379f, 0.382f },
-		{ 0.380f, 0.300f }, { 0.346f, 0.346f }, { 0.289f, 0.290f }, { 0.272f, 0.271f },
-		{ 0.192f, 0.193f }, { 0.193f, 0.192f }, { 0.217f, 0.217f }, { 0.181f, 0.195f },
-		{ 0.180f, 0.192f }, { 0.181f, 0.166f }, { 0.176f, 0.186f }, { 0.142f, 0.131f },
-		{ 0.167f, 0.168f }, { 0.134f, 0.133f }
+// write a value into a tap line; the first 3 values of the ring are repeated after its end, so 4
+// values in a row can be read without wrapping
+static inline void earlyref_write(sf_rv_delay_st *delay, float v){
+	delay->buf[delay->pos] = v;
+	if (delay->pos < 3)
+		delay->buf[delay->mask + 1 + delay->pos] = v;
+	delay->pos = (delay->pos + 1) & delay->mask;
+}
+
+// sum the taps for each sample of a block that was just written to the tap line; the sums of
+// different samples don't depend on each other, so SSE2 calculates four at once
+static inline void earlyref_taps(sf_rv_delay_st *delay, const int *delaytbl, const float *gaintbl,
+	int len, float *wet){
+	int mask = delay->mask;
+	int start = (delay->pos - len) & mask;
+	// a tap of 1 reads the value written for the same sample, and the taps are clamped to 1..size
+	int offset[18];
+	for (int i = 0; i < 18; i++)
+		offset[i] = delaytbl[i] > delay->size ? delay->size : (delaytbl[i] <= 0 ? 1 : delaytbl[i]);
+
+	int k = 0;
+	#if defined(__SSE2__)
+	for (; k + 4 <= len; k += 4){
+		__m128 sum = _mm_setzero_ps();
+		for (int i = 0; i < 18; i++){
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(gaintbl[i]),
+				_mm_loadu_ps(&delay->buf[(start + k + 1 - offset[i]) & mask])));
+		}
+		_mm_storeu_ps(&wet[k], sum);
+	}
+	#endif
+	for (; k < len; k++){
+		float sum = 0;
+		for (int i = 0; i < 18; i++)
+			sum += gaintbl[i] * delay->buf[(start + k + 1 - offset[i]) & mask];
+		wet[k] = sum;
+	}
+}
+
+// len must be at most SF_REVERB_BLOCK
+static inline void earlyref_process(sf_rv_earlyref_st *earlyref, int len, sf_sample_st *input,
+	sf_sample_st *output){
+	static const float gaintblL[18] = {
+		0.841f, 0.504f, 0.491f, 0.379f, 0.380f, 0.346f, 0.289f, 0.272f, 0.192f,
+		0.193f, 0.217f, 0.181f, 0.180f, 0.181f, 0.176f, 0.142f, 0.167f, 0.134f
+	};
+	static const float gaintblR[18] = {
+		0.842f, 0.506f, 0.489f, 0.382f, 0.300f, 0.346f, 0.290f, 0.271f, 0.193f,
+		0.192f, 0.217f, 0.195f, 0.192f, 0.166f, 0.186f, 0.131f, 0.168f, 0.133f
 	};
 
-	float wetL = 0, wetR = 0;
-	delay_step(&earlyref->delayPWL, input.L);
-	delay_step(&earlyref->delayPWR, input.R);
-	for (int i = 0; i < 18; i++){
-		wetL += gaintbl[i].L * delay_get(&earlyref->delayPWL, earlyref->delaytblL[i]);
-		wetR += gaintbl[i].R * delay_get(&earlyref->delayPWR, earlyref->delaytblR[i]);
+	for (int k = 0; k < len; k++){
+		earlyref_write(&earlyref->delayPWL, input[k].L);
+		earlyref_write(&earlyref->delayPWR, input[k].R);
 	}
+	float wetL[SF_REVERB_BLOCK], wetR[SF_REVERB_BLOCK];
+	earlyref_taps(&earlyref->delayPWL, earlyref->delaytblL, gaintblL, len, wetL);
+	earlyref_taps(&earlyref->delayPWR, earlyref->delaytblR, gaintblR, len, wetR);
+
+	for (int k = 0; k < len; k++){
+		float L = delay_step(&earlyref->delayRL, input[k].R + wetR[k]);
+		L = biquad_step(&earlyref->allpassXL, L);
+		L = biquad_step(&earlyref->allpassL, earlyref->wet1 * wetL[k] + earlyref->wet2 * L);
+		L = iir1_step(&earlyref->hpfL, L);
+		L = iir1_step(&earlyref->lpfL, L);
+
+		float R = delay_step(&earlyref->delayLR, input[k].L + wetL[k]);
+		R = biquad_step(&earlyref->allpassXR, R);
+		R = biquad_step(&earlyref->allpassR, earlyref->wet1 * wetR[k] + earlyref->wet2 * R);
+		R = iir1_step(&earlyref->hpfR, R);
+		R = iir1_step(&earlyref->lpfR, R);
+
+		output[k] = (sf_sample_st){ L, R };
+	}
+}
 
-	float L = delay_step(&earlyref->delayRL, input.R + wetR);
-	L = biquad_step(&earlyref->allpassXL, L);
-	L = biquad_step(&earlyref->allpassL, earlyref->wet1 * wetL + earlyref->wet2 * L);
-	L = iir1_step(&earlyref->hpfL, L);
-	L = iir1_step(&earlyref->lpfL, L);
+//
+// stereo components
+//
+// the tank components are stereo (see reverb.h); they work on `lr_v` values, which hold a sample
+// of each channel, so the same code advances both channels with SSE2, or one at a time without it
+//
+#if defined(__SSE2__)
+typedef __m128 lr_v; // only the lower two lanes are used
 
-	float R = delay_step(&earlyref->delayLR, input.L + wetL);
-	R = biquad_step(&earlyref->allpassXR, R);
-	R = biquad_step(&earlyref->allpassR, earlyref->wet1 * wetR + earlyref->wet2 * R);
-	R = iir1_step(&earlyref->hpfR, R);
-	R = iir1_step(&earlyref->lpfR, R);
+static inline lr_v lr_set(float L, float R){
+	return _mm_setr_ps(L, R, 0, 0);
+}
 
-	return (sf_sample_st){ L, R };
+static inline lr_v lr_set1(float v){
+	return _mm_set1_ps(v);
+}
+
+// sf_sample_st is only aligned to a float, so these use the unaligned 64-bit moves
+static inline lr_v lr_load(const sf_sample_st *s){
+	return _mm_castsi128_ps(_mm_loadl_epi64((const __m128i *)s));
+}
+
+static inline void lr_store(sf_sample_st *s, lr_v v){
+	_mm_storel_epi64((__m128i *)s, _mm_castps_si128(v));
+}
+
+static inline lr_v lr_add(lr_v a, lr_v b){ return _mm_add_ps(a, b); }
+static inline lr_v lr_sub(lr_v a, lr_v b){ return _mm_sub_ps(a, b); }
+static inline lr_v lr_mul(lr_v a, lr_v b){ return _mm_mul_ps(a, b); }
+
+// L and R trade places
+static inline lr_v lr_swap(lr_v v){
+	return _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 2, 0, 1));
+}
+
+// floor of a non-negative value, also returned as integers
+static inline lr_v lr_floor(lr_v v, int *L, int *R){
+	__m128i i = _mm_cvttps_epi32(v);
+	*L = _mm_cvtsi128_si32(i);
+	*R = _mm_cvtsi128_si32(_mm_shuffle_epi32(i, _MM_SHUFFLE(1, 1, 1, 1)));
+	return _mm_cvtepi32_ps(i);
+}
+#else
+typedef sf_sample_st lr_v;
+
+static inline lr_v lr_set(float L, float R){
+	return (lr_v){ L, R };
+}
+
+static inline lr_v lr_set1(float v){
+	return (lr_v){ v, v };
+}
+
+static inline lr_v lr_load(const sf_sample_st *s){
+	return *s;
+}
+
+static inline void lr_store(sf_sample_st *s, lr_v v){
+	*s = v;
+}
+
+static inline lr_v lr_add(lr_v a, lr_v b){ return (lr_v){ a.L + b.L, a.R + b.R }; }
+static inline lr_v lr_sub(lr_v a, lr_v b){ return (lr_v){ a.L - b.L, a.R - b.R }; }
+static inline lr_v lr_mul(lr_v a, lr_v b){ return (lr_v){ a.L * b.L, a.R * b.R }; }
+
+// L and R trade places
+static inline lr_v lr_swap(lr_v v){
+	return (lr_v){ v.R, v.L };
+}
+
+// floor of a non-negative value, also returned as integers
+static inline lr_v lr_floor(lr_v v, int *L, int *R){
+	v.L = floorf(v.L);
+	v.R = floorf(v.R);
+	*L = (int)v.L;
+	*R = (int)v.R;
+	return v;
+}
+#endif
+
+// read the left channel of one position and the right channel of another
+static inline lr_v lr_gather(const sf_sample_st *buf, int posL, int posR){
+	return lr_set(buf[posL].L, buf[posR].R);
+}
+
+//
+// delaylr
+//
+static inline void delaylr_make(sf_rv_delaylr_st *delay, int sizeL, int sizeR){
+	delay->pos = 0;
+	delay->sizeL = sizeL < 1 ? 1 : sizeL;
+	delay->sizeR = sizeR < 1 ? 1 : sizeR;
+	delay->mask = ring_mask(delay->sizeL > delay->sizeR ? delay->sizeL : delay->sizeR);
+	delay->buf = NULL;
+}
+
+static inline lr_v delaylr_getlast(sf_rv_delaylr_st *delay){
+	return lr_gather(delay->buf, (delay->pos - delay->sizeL) & delay->mask,
+		(delay->pos - delay->sizeR) & delay->mask);
+}
+
+static inline lr_v delaylr_step(sf_rv_delaylr_st *delay, lr_v v){
+	lr_v out = delaylr_getlast(delay);
+	lr_store(&delay->buf[delay->pos], v);
+	delay->pos = (delay->pos + 1) & delay->mask;
+	return out;
+}
+
+// delaylr_getL(d, 1) returns the last written left value
+// delaylr_getL(d, 2) returns the second-last written left value
+// ..etc (the offset is clamped to 1..sizeL)
+static inline float delaylr_getL(sf_rv_delaylr_st *delay, int offset){
+	if (offset > delay->sizeL)
+		offset = delay->sizeL;
+	else if (offset <= 0)
+		offset = 1;
+	return delay->buf[(delay->pos - offset) & delay->mask].L;
+}
+
+static inline float delaylr_getR(sf_rv_delaylr_st *delay, int offset){
+	if (offset > delay->sizeR)
+		offset = delay->sizeR;
+	else if (offset <= 0)
+		offset = 1;
+	return delay->buf[(delay->pos - offset) & delay->mask].R;
+}
+
+//
+// iir1lr
+//
+static inline void iir1lr_makeLPF(sf_rv_iir1lr_st *iir1, int rate, float freq){
+	sf_rv_iir1_st mono;
+	iir1_makeLPF(&mono, rate, freq);
+	iir1->a2 = mono.a2;
+	iir1->b1 = mono.b1;
+	iir1->b2 = mono.b2;
+	iir1->y1 = (sf_sample_st){ 0, 0 };
+}
+
+static inline lr_v iir1lr_step(sf_rv_iir1lr_st *iir1, lr_v v){
+	lr_v out = lr_add(lr_mul(v, lr_set1(iir1->b1)), lr_load(&iir1->y1));
+	lr_store(&iir1->y1, lr_add(lr_add(lr_mul(out, lr_set1(iir1->a2)),
+		lr_mul(v, lr_set1(iir1->b2))), lr_set1(SF_DENORMAL_OFFSET)));
+	return out;
+}
+
+//
+// biquadlr
+//
+static inline void biquadlr_make(sf_rv_biquadlr_st *biquad, const sf_rv_biquad_st *mono){
+	biquad->b0 = mono->b0;
+	biquad->b1 = mono->b1;
+	biquad->b2 = mono->b2;
+	biquad->a1 = mono->a1;
+	biquad->a2 = mono->a2;
+	biquad->xn1 = biquad->xn2 = biquad->yn1 = biquad->yn2 = (sf_sample_st){ 0, 0 };
+}
+
+static inline lr_v biquadlr_step(sf_rv_biquadlr_st *biquad, lr_v v){
+	lr_v xn1 = lr_load(&biquad->xn1);
+	lr_v yn1 = lr_load(&biquad->yn1);
+	lr_v out = lr_mul(v, lr_set1(biquad->b0));
+	out = lr_add(out, lr_mul(xn1, lr_set1(biquad->b1)));
+	out = lr_add(out, lr_mul(lr_load(&biquad->xn2), lr_set1(biquad->b2)));
+	out = lr_sub(out, lr_mul(yn1, lr_set1(biquad->a1)));
+	out = lr_sub(out, lr_mul(lr_load(&biquad->yn2), lr_set1(biquad->a2)));
+	lr_store(&biquad->xn2, xn1);
+	lr_store(&biquad->xn1, v);
+	lr_store(&biquad->yn2, yn1);
+	lr_store(&biquad->yn1, out);
+	return out;
 }
 
 //
@@ -282,29 +504,31 @@ static inline sf_sample_st earlyref_step(sf_rv_earlyref_st *earlyref, sf_sample_
 //
 static inline void oversample_make(sf_rv_oversample_st *oversample, int factor){
 	oversample->factor = clampi(factor, 1, SF_REVERB_OF);
-	biquad_makeLPFQ(&oversample->lpfU, 2 * oversample->factor, 1.0f,
-		0.5773502691896258f); // 1/sqrt(3)
+	sf_rv_biquad_st lpf;
+	biquad_makeLPFQ(&lpf, 2 * oversample->factor, 1.0f, 0.5773502691896258f); // 1/sqrt(3)
+	biquadlr_make(&oversample->lpfU, &lpf);
 	oversample->lpfD = oversample->lpfU;
 }
 
 // output length must be oversample->factor
-static inline void oversample_stepup(sf_rv_oversample_st *oversample, float input, float *output){
+static inline void oversample_stepup(sf_rv_oversample_st *oversample, lr_v input, lr_v *output){
 	if (oversample->factor == 1){
 		output[0] = input;
 		return;
 	}
-	output[0] = biquad_step(&oversample->lpfU, input * oversample->factor);
+	output[0] = biquadlr_step(&oversample->lpfU,
+		lr_mul(input, lr_set1((float)oversample->factor)));
 	for (int i = 1; i < oversample->factor; i++)
-		output[i] = biquad_step(&oversample->lpfU, 0);
+		output[i] = biquadlr_step(&oversample->lpfU, lr_set1(0));
 }
 
 // input length must be oversample->factor
-static inline float oversample_stepdown(sf_rv_oversample_st *oversample, float *input){
+static inline lr_v oversample_stepdown(sf_rv_oversample_st *oversample, lr_v *input){
 	if (oversample->factor == 1)
 		return input[0];
-	float out = biquad_step(&oversample->lpfD, input[0]);
+	lr_v out = biquadlr_step(&oversample->lpfD, input[0]);
 	for (int i = 1; i < oversample->factor; i++)
-		biquad_step(&oversample->lpfD, input[i]);
+		biquadlr_step(&oversample->lpfD, input[i]);
 	return out;
 }
 
@@ -317,14 +541,15 @@ static inline void dccut_make(sf_rv_dccut_st *dccut, int rate, float freq){
 	float sn = sinf(ang);
 	float sqrt3 = 1.7320508075688772f;
 	dccut->gain = (sqrt3 - 2.0f * sn) / (sn + sqrt3 * cosf(ang));
-	dccut->y1 = 0;
-	dccut->y2 = 0;
+	dccut->y1 = (sf_sample_st){ 0, 0 };
+	dccut->y2 = (sf_sample_st){ 0, 0 };
 }
 
-static inline float dccut_step(sf_rv_dccut_st *dccut, float v){
-	float out = v - dccut->y1 + dccut->gain * dccut->y2;
-	dccut->y1 = v;
-	dccut->y2 = out;
+static inline lr_v dccut_step(sf_rv_dccut_st *dccut, lr_v v){
+	lr_v out = lr_add(lr_sub(v, lr_load(&dccut->y1)),
+		lr_mul(lr_set1(dccut->gain), lr_load(&dccut->y2)));
+	lr_store(&dccut->y1, v);
+	lr_store(&dccut->y2, out);
 	return out;
 }
 
@@ -333,6 +558,7 @@ static inline float dccut_step(sf_rv_dccut_st *dccut, float v){
 //
 static inline void noise_make(sf_rv_noise_st *noise){
 	noise->pos = SF_REVERB_NS;
+	noise->buf = NULL;
 }
 
 static inline float noise_step(sf_rv_noise_st *noise){
@@ -393,199 +619,294 @@ static inline float lfo_step(sf_rv_lfo_st *lfo){
 //
 // allpass
 //
-static inline void allpass_make(sf_rv_allpass_st *allpass, int size, float feedback, float decay){
+static inline void allpass_make(sf_rv_allpass_st *allpass, int sizeL, int sizeR, float feedback,
+	float decay){
 	allpass->pos = 0;
-	allpass->size = clampi(size, 1, SF_REVERB_APS);
+	allpass->sizeL = sizeL < 1 ? 1 : sizeL;
+	allpass->sizeR = sizeR < 1 ? 1 : sizeR;
+	allpass->mask = ring_mask(allpass->sizeL > allpass->sizeR ? allpass->sizeL : allpass->sizeR);
 	allpass->feedback = feedback;
 	allpass->decay = decay;
-	memset(allpass->buf, 0, sizeof(float) * allpass->size);
+	allpass->buf = NULL;
 }
 
-static inline float allpass_step(sf_rv_allpass_st *allpass, float v){
-	v += allpass->feedback * allpass->buf[allpass->pos];
-	float out = allpass->decay * allpass->buf[allpass->pos] - allpass->feedback * v;
-	allpass->buf[allpass->pos] = v;
-	allpass->pos = (allpass->pos + 1) % allpass->size;
+static inline lr_v allpass_step(sf_rv_allpass_st *allpass, lr_v v){
+	lr_v feedback = lr_set1(allpass->feedback);
+	lr_v last = lr_gather(allpass->buf, (allpass->pos - allpass->sizeL) & allpass->mask,
+		(allpass->pos - allpass->sizeR) & allpass->mask);
+	v = lr_add(v, lr_mul(feedback, last));
+	lr_v out = lr_sub(lr_mul(lr_set1(allpass->decay), last), lr_mul(feedback, v));
+	lr_store(&allpass->buf[allpass->pos], v);
+	allpass->pos = (allpass->pos + 1) & allpass->mask;
 	return out;
 }
 
 //
 // allpass2
 //
-static inline void allpass2_make(sf_rv_allpass2_st *allpass2, int size1, int size2, float feedback1,
-	float feedback2, float decay1, float decay2){
+static inline void allpass2_make(sf_rv_allpass2_st *allpass2, int size1L, int size1R, int size2L,
+	int size2R, float feedback1, float feedback2, float decay1, float decay2){
 	allpass2->pos1 = 0;
 	allpass2->pos2 = 0;
-	allpass2->size1 = clampi(size1, 1, SF_REVERB_AP2S1);
-	allpass2->size2 = clampi(size2, 1, SF_REVERB_AP2S2);
+	allpass2->size1L = size1L < 1 ? 1 : size1L;
+	allpass2->size1R = size1R < 1 ? 1 : size1R;
+	allpass2->size2L = size2L < 1 ? 1 : size2L;
+	allpass2->size2R = size2R < 1 ? 1 : size2R;
+	allpass2->mask1 = ring_mask(
+		allpass2->size1L > allpass2->size1R ? allpass2->size1L : allpass2->size1R);
+	allpass2->mask2 = ring_mask(
+		allpass2->size2L > allpass2->size2R ? allpass2->size2L : allpass2->size2R);
 	allpass2->feedback1 = feedback1;
 	allpass2->feedback2 = feedback2;
 	allpass2->decay1 = decay1;
 	allpass2->decay2 = decay2;
-	memset(allpass2->buf1, 0, sizeof(float) * allpass2->size1);
-	memset(allpass2->buf2, 0, sizeof(float) * allpass2->size2);
-}
-
-static inline float allpass2_step(sf_rv_allpass2_st *allpass2, float v){
-	v += allpass2->feedback2 * allpass2->buf2[allpass2->pos2];
-	float out = allpass2->decay2 * allpass2->buf2[allpass2->pos2] - v * allpass2->feedback2;
-	v += allpass2->feedback1 * allpass2->buf1[allpass2->pos1];
-	allpass2->buf2[allpass2->pos2] = allpass2->decay1 * allpass2->buf1[allpass2->pos1] -
-		v * allpass2->feedback1;
-	allpass2->buf1[allpass2->pos1] = v;
-	allpass2->pos1 = (allpass2->pos1 + 1) % allpass2->size1;
-	allpass2->pos2 = (allpass2->pos2 + 1) % allpass2->size2;
+	allpass2->buf1 = NULL;
+	allpass2->buf2 = NULL;
+}
+
+static inline lr_v allpass2_step(sf_rv_allpass2_st *allpass2, lr_v v){
+	lr_v feedback1 = lr_set1(allpass2->feedback1);
+	lr_v feedback2 = lr_set1(allpass2->feedback2);
+	lr_v last1 = lr_gather(allpass2->buf1,
+		(allpass2->pos1 - allpass2->size1L) & allpass2->mask1,
+		(allpass2->pos1 - allpass2->size1R) & allpass2->mask1);
+	lr_v last2 = lr_gather(allpass2->buf2,
+		(allpass2->pos2 - allpass2->size2L) & allpass2->mask2,
+		(allpass2->pos2 - allpass2->size2R) & allpass2->mask2);
+	v = lr_add(v, lr_mul(feedback2, last2));
+	lr_v out = lr_sub(lr_mul(lr_set1(allpass2->decay2), last2), lr_mul(v, feedback2));
+	v = lr_add(v, lr_mul(feedback1, last1));
+	lr_store(&allpass2->buf2[allpass2->pos2],
+		lr_sub(lr_mul(lr_set1(allpass2->decay1), last1), lr_mul(v, feedback1)));
+	lr_store(&allpass2->buf1[allpass2->pos1], v);
+	allpass2->pos1 = (allpass2->pos1 + 1) & allpass2->mask1;
+	allpass2->pos2 = (allpass2->pos2 + 1) & allpass2->mask2;
 	return out;
 }
 
-static inline float allpass2_get1(sf_rv_allpass2_st *allpass2, int offset){
-	if (offset > allpass2->size1)
-		return allpass2->buf1[allpass2->pos1];
+// same as delaylr_getL, for one channel of one line
+static inline float allpass2_get1L(sf_rv_allpass2_st *allpass2, int offset){
+	if (offset > allpass2->size1L)
+		offset = allpass2->size1L;
+	else if (offset <= 0)
+		offset = 1;
+	return allpass2->buf1[(allpass2->pos1 - offset) & allpass2->mask1].L;
+}
+
+static inline float allpass2_get1R(sf_rv_allpass2_st *allpass2, int offset){
+	if (offset > allpass2->size1R)
+		offset = allpass2->size1R;
+	else if (offset <= 0)
+		offset = 1;
+	return allpass2->buf1[(allpass2->pos1 - offset) & allpass2->mask1].R;
+}
+
+static inline float allpass2_get2L(sf_rv_allpass2_st *allpass2, int offset){
+	if (offset > allpass2->size2L)
+		offset = allpass2->size2L;
 	else if (offset <= 0)
 		offset = 1;
-	int rp = allpass2->pos1 - offset;
-	if (rp < 0)
-		rp += allpass2->size1;
-	return allpass2->buf1[rp];
+	return allpass2->buf2[(allpass2->pos2 - offset) & allpass2->mask2].L;
 }
 
-static inline float allpass2_get2(sf_rv_allpass2_st *allpass2, int offset){
-	if (offset > allpass2->size2)
-		return allpass2->buf2[allpass2->pos2];
+static inline float allpass2_get2R(sf_rv_allpass2_st *allpass2, int offset){
+	if (offset > allpass2->size2R)
+		offset = allpass2->size2R;
 	else if (offset <= 0)
 		offset = 1;
-	int rp = allpass2->pos2 - offset;
-	if (rp < 0)
-		rp += allpass2->size2;
-	return allpass2->buf2[rp];
+	return allpass2->buf2[(allpass2->pos2 - offset) & allpass2->mask2].R;
 }
 
 //
 // allpass3
 //
-static inline void allpass3_make(sf_rv_allpass3_st *allpass3, int size1, int msize1, int size2,
-	int size3, float feedback1, float feedback2, float feedback3, float decay1, float decay2,
-	float decay3){
-	size1 = clampi(size1, 1, SF_REVERB_AP3S1);
-	msize1 = clampi(msize1, 1, SF_REVERB_AP3M1);
-	if (msize1 > size1)
-		msize1 = size1;
-	int newsize = size1 + msize1;
-	allpass3->rpos1 = (msize1 * 2) % newsize;
-	allpass3->wpos1 = 0;
+// the modulated line reads `size1 - 2 * msize1 + floor((mod + 1) * msize1)` values behind the
+// write position (and one more for the interpolation), so for mod in (-1, 1) the reads stay within
+// size1 + 1 values, which is what the ring holds
+static inline void allpass3_make(sf_rv_allpass3_st *allpass3, int size1L, int size1R, int msize1L,
+	int msize1R, int size2L, int size2R, int size3L, int size3R, float feedback1, float feedback2,
+	float feedback3, float decay1, float decay2, float decay3){
+	if (size1L < 1)
+		size1L = 1;
+	if (size1R < 1)
+		size1R = 1;
+	if (msize1L < 1)
+		msize1L = 1;
+	if (msize1R < 1)
+		msize1R = 1;
+	if (msize1L > size1L)
+		msize1L = size1L;
+	if (msize1R > size1R)
+		msize1R = size1R;
+	allpass3->pos1 = 0;
 	allpass3->pos2 = 0;
 	allpass3->pos3 = 0;
-	allpass3->size1 = newsize;
-	allpass3->msize1 = msize1;
-	allpass3->size2 = clampi(size2, 1, SF_REVERB_AP3S2);
-	allpass3->size3 = clampi(size3, 1, SF_REVERB_AP3S3);
+	allpass3->size1L = size1L + msize1L;
+	allpass3->size1R = size1R + msize1R;
+	allpass3->msize1L = msize1L;
+	allpass3->msize1R = msize1R;
+	allpass3->size2L = size2L < 1 ? 1 : size2L;
+	allpass3->size2R = size2R < 1 ? 1 : size2R;
+	allpass3->size3L = size3L < 1 ? 1 : size3L;
+	allpass3->size3R = size3R < 1 ? 1 : size3R;
+	allpass3->mask1 = ring_mask(
+		(allpass3->size1L > allpass3->size1R ? allpass3->size1L : allpass3->size1R) + 1);
+	allpass3->mask2 = ring_mask(
+		allpass3->size2L > allpass3->size2R ? allpass3->size2L : allpass3->size2R);
+	allpass3->mask3 = ring_mask(
+		allpass3->size3L > allpass3->size3R ? allpass3->size3L : allpass3->size3R);
 	allpass3->feedback1 = feedback1;
 	allpass3->feedback2 = feedback2;
 	allpass3->feedback3 = feedback3;
 	allpass3->decay1 = decay1;
 	allpass3->decay2 = decay2;
 	allpass3->decay3 = decay3;
-	memset(allpass3->buf1, 0, sizeof(float) * allpass3->size1);
-	memset(allpass3->buf2, 0, sizeof(float) * allpass3->size2);
-	memset(allpass3->buf3, 0, sizeof(float) * allpass3->size3);
-}
-
-static inline float allpass3_step(sf_rv_allpass3_st *allpass3, float v, float mod){
-	mod = (mod + 1.0f) * (float)allpass3->msize1;
-	float floormod = floorf(mod);
-	float mfrac = mod - floormod;
-	int rpos1 = allpass3->rpos1 - (int)floormod;
-	if (rpos1 < 0)
-		rpos1 += allpass3->size1;
-	int rpos2 = rpos1 - 1;
-	if (rpos2 < 0)
-		rpos2 += allpass3->size1;
-	v += allpass3->feedback3 * allpass3->buf3[allpass3->pos3];
-	float out = allpass3->decay3 * allpass3->buf3[allpass3->pos3] - allpass3->feedback3 * v;
-	v += allpass3->feedback2 * allpass3->buf2[allpass3->pos2];
-	allpass3->buf3[allpass3->pos3] = allpass3->decay2 * allpass3->buf2[allpass3->pos2] -
-		allpass3->feedback2 * v;
-	float tmp = allpass3->buf1[rpos2] * mfrac + allpass3->buf1[rpos1] * (1.0f - mfrac);
-	v += allpass3->feedback1 * tmp;
-	allpass3->buf2[allpass3->pos2] = allpass3->decay1 * tmp - allpass3->feedback1 * v;
-	allpass3->buf1[allpass3->wpos1] = v;
-	allpass3->wpos1 = (allpass3->wpos1 + 1) % allpass3->size1;
-	allpass3->rpos1 = (allpass3->rpos1 + 1) % allpass3->size1;
-	allpass3->pos2 = (allpass3->pos2 + 1) % allpass3->size2;
-	allpass3->pos3 = (allpass3->pos3 + 1) % allpass3->size3;
+	allpass3->buf1 = NULL;
+	allpass3->buf2 = NULL;
+	allpass3->buf3 = NULL;
+}
+
+static inline lr_v allpass3_step(sf_rv_allpass3_st *allpass3, lr_v v, lr_v mod){
+	lr_v feedback1 = lr_set1(allpass3->feedback1);
+	lr_v feedback2 = lr_set1(allpass3->feedback2);
+	lr_v feedback3 = lr_set1(allpass3->feedback3);
+	mod = lr_mul(lr_add(mod, lr_set1(1.0f)),
+		lr_set((float)allpass3->msize1L, (float)allpass3->msize1R));
+	int floorL, floorR;
+	lr_v mfrac = lr_sub(mod, lr_floor(mod, &floorL, &floorR));
+	int rpos1L = allpass3->pos1 - (allpass3->size1L - 2 * allpass3->msize1L) - floorL;
+	int rpos1R = allpass3->pos1 - (allpass3->size1R - 2 * allpass3->msize1R) - floorR;
+	lr_v last2 = lr_gather(allpass3->buf2,
+		(allpass3->pos2 - allpass3->size2L) & allpass3->mask2,
+		(allpass3->pos2 - allpass3->size2R) & allpass3->mask2);
+	lr_v last3 = lr_gather(allpass3->buf3,
+		(allpass3->pos3 - allpass3->size3L) & allpass3->mask3,
+		(allpass3->pos3 - allpass3->size3R) & allpass3->mask3);
+	v = lr_add(v, lr_mul(feedback3, last3));
+	lr_v out = lr_sub(lr_mul(lr_set1(allpass3->decay3), last3), lr_mul(feedback3, v));
+	v = lr_add(v, lr_mul(feedback2, last2));
+	lr_store(&allpass3->buf3[allpass3->pos3],
+		lr_sub(lr_mul(lr_set1(allpass3->decay2), last2), lr_mul(feedback2, v)));
+	lr_v tmp = lr_add(
+		lr_mul(lr_gather(allpass3->buf1, (rpos1L - 1) & allpass3->mask1,
+			(rpos1R - 1) & allpass3->mask1), mfrac),
+		lr_mul(lr_gather(allpass3->buf1, rpos1L & allpass3->mask1, rpos1R & allpass3->mask1),
+			lr_sub(lr_set1(1.0f), mfrac)));
+	v = lr_add(v, lr_mul(feedback1, tmp));
+	lr_store(&allpass3->buf2[allpass3->pos2],
+		lr_sub(lr_mul(lr_set1(allpass3->decay1), tmp), lr_mul(feedback1, v)));
+	lr_store(&allpass3->buf1[allpass3->pos1], v);
+	allpass3->pos1 = (allpass3->pos1 + 1) & allpass3->mask1;
+	allpass3->pos2 = (allpass3->pos2 + 1) & allpass3->mask2;
+	allpass3->pos3 = (allpass3->pos3 + 1) & allpass3->mask3;
 	return out;
 }
 
-static inline float allpass3_get1(sf_rv_allpass3_st *allpass3, int offset){
-	if (offset > allpass3->size1)
-		return allpass3->buf1[allpass3->rpos1];
+// offsets into the first line are behind the unmodulated read position, and wrap around the line
+static inline float allpass3_get1L(sf_rv_allpass3_st *allpass3, int offset){
+	if (offset > allpass3->size1L)
+		offset = 0;
+	else if (offset <= 0)
+		offset = 1;
+	int back = allpass3->size1L - 2 * allpass3->msize1L + offset;
+	if (back > allpass3->size1L)
+		back -= allpass3->size1L;
+	else if (back <= 0)
+		back += allpass3->size1L;
+	return allpass3->buf1[(allpass3->pos1 - back) & allpass3->mask1].L;
+}
+
+static inline float allpass3_get1R(sf_rv_allpass3_st *allpass3, int offset){
+	if (offset > allpass3->size1R)
+		offset = 0;
 	else if (offset <= 0)
 		offset = 1;
-	int rp = allpass3->rpos1 - offset;
-	if (rp < 0)
-		rp += allpass3->size1;
-	return allpass3->buf1[rp];
+	int back = allpass3->size1R - 2 * allpass3->msize1R + offset;
+	if (back > allpass3->size1R)
+		back -= allpass3->size1R;
+	else if (back <= 0)
+		back += allpass3->size1R;
+	return allpass3->buf1[(allpass3->pos1 - back) & allpass3->mask1].R;
 }
 
-static inline float allpass3_get2(sf_rv_allpass3_st *allpass3, int offset){
-	if (offset > allpass3->size2)
-		return allpass3->buf2[allpass3->pos2];
+// same as delaylr_getL, for one channel of the other lines
+static inline float allpass3_get2L(sf_rv_allpass3_st *allpass3, int offset){
+	if (offset > allpass3->size2L)
+		offset = allpass3->size2L;
 	else if (offset <= 0)
 		offset = 1;
-	int rp = allpass3->pos2 - offset;
-	if (rp < 0)
-		rp += allpass3->size2;
-	return allpass3->buf2[rp];
+	return allpass3->buf2[(allpass3->pos2 - offset) & allpass3->mask2].L;
 }
 
-static inline float allpass3_get3(sf_rv_allpass3_st *allpass3, int offset){
-	if (offset > allpass3->size3)
-		return allpass3->buf3[allpass3->pos3];
+static inline float allpass3_get2R(sf_rv_allpass3_st *allpass3, int offset){
+	if (offset > allpass3->size2R)
+		offset = allpass3->size2R;
 	else if (offset <= 0)
 		offset = 1;
-	int rp = allpass3->pos3 - offset;
-	if (rp < 0)
-		rp += allpass3->size3;
-	return allpass3->buf3[rp];
+	return allpass3->buf2[(allpass3->pos2 - offset) & allpass3->mask2].R;
+}
+
+static inline float allpass3_get3L(sf_rv_allpass3_st *allpass3, int offset){
+	if (offset > allpass3->size3L)
+		offset = allpass3->size3L;
+	else if (offset <= 0)
+		offset = 1;
+	return allpass3->buf3[(allpass3->pos3 - offset) & allpass3->mask3].L;
+}
+
+static inline float allpass3_get3R(sf_rv_allpass3_st *allpass3, int offset){
+	if (offset > allpass3->size3R)
+		offset = allpass3->size3R;
+	else if (offset <= 0)
+		offset = 1;
+	return allpass3->buf3[(allpass3->pos3 - offset) & allpass3->mask3].R;
 }
 
 //
 // allpassm
 //
-static inline void allpassm_make(sf_rv_allpassm_st *allpassm, int size, int msize, float feedback,
-	float decay){
-	size = clampi(size, 1, SF_REVERB_APMS);
-	msize = clampi(msize, 1, SF_REVERB_APMM);
-	if (msize > size)
-		msize = size;
-	int newsize = size + msize;
-	allpassm->rpos = (msize * 2) % newsize;
-	allpassm->wpos = 0;
-	allpassm->size = newsize;
+// reads like the first line of allpass3
+static inline void allpassm_make(sf_rv_allpassm_st *allpassm, int sizeL, int sizeR, int msize,
+	float feedback, float decay){
+	if (sizeL < 1)
+		sizeL = 1;
+	if (sizeR < 1)
+		sizeR = 1;
+	if (msize < 1)
+		msize = 1;
+	if (msize > sizeL)
+		msize = sizeL;
+	if (msize > sizeR)
+		msize = sizeR;
+	allpassm->pos = 0;
+	allpassm->sizeL = sizeL + msize;
+	allpassm->sizeR = sizeR + msize;
 	allpassm->msize = msize;
+	allpassm->mask = ring_mask(
+		(allpassm->sizeL > allpassm->sizeR ? allpassm->sizeL : allpassm->sizeR) + 1);
 	allpassm->feedback = feedback;
 	allpassm->decay = decay;
-	allpassm->z1 = 0;
-	memset(allpassm->buf, 0, sizeof(float) * allpassm->size);
-}
-
-static inline float allpassm_step(sf_rv_allpassm_st *allpassm, float v, float mod, float fbmod){
-	float mfeedback = allpassm->feedback + fbmod;
-	mod = (mod + 1.0f) * (float)allpassm->msize;
-	float floormod = floorf(mod);
-	float mfrac = 1.0f - mod + floormod;
-	int rpos1 = allpassm->rpos - (int)floormod;
-	if (rpos1 < 0)
-		rpos1 += allpassm->size;
-	int rpos2 = rpos1 - 1;
-	if (rpos2 < 0)
-		rpos2 += allpassm->size;
-	allpassm->z1 = allpassm->buf[rpos2] + mfrac * (allpassm->buf[rpos1] - allpassm->z1);
-	allpassm->rpos = (allpassm->rpos + 1) % allpassm->size;
-	allpassm->buf[allpassm->wpos] = v + allpassm->z1 * mfeedback;
-	v = allpassm->decay * allpassm->z1 - allpassm->buf[allpassm->wpos] * mfeedback;
-	allpassm->wpos = (allpassm->wpos + 1) % allpassm->size;
-	return v;
+	allpassm->z1 = (sf_sample_st){ 0, 0 };
+	allpassm->buf = NULL;
+}
+
+static inline lr_v allpassm_step(sf_rv_allpassm_st *allpassm, lr_v v, lr_v mod, lr_v fbmod){
+	lr_v mfeedback = lr_add(lr_set1(allpassm->feedback), fbmod);
+	mod = lr_mul(lr_add(mod, lr_set1(1.0f)), lr_set1((float)allpassm->msize));
+	int floorL, floorR;
+	lr_v mfrac = lr_add(lr_sub(lr_set1(1.0f), mod), lr_floor(mod, &floorL, &floorR));
+	int rpos1L = allpassm->pos - (allpassm->sizeL - 2 * allpassm->msize) - floorL;
+	int rpos1R = allpassm->pos - (allpassm->sizeR - 2 * allpassm->msize) - floorR;
+	lr_v z1 = lr_add(
+		lr_gather(allpassm->buf, (rpos1L - 1) & allpassm->mask, (rpos1R - 1) & allpassm->mask),
+		lr_mul(mfrac, lr_sub(
+			lr_gather(allpassm->buf, rpos1L & allpassm->mask, rpos1R & allpassm->mask),
+			lr_load(&allpassm->z1))));
+	lr_store(&allpassm->z1, z1);
+	lr_v w = lr_add(lr_add(v, lr_mul(z1, mfeedback)), lr_set1(SF_DENORMAL_OFFSET));
+	lr_store(&allpassm->buf[allpassm->pos], w);
+	allpassm->pos = (allpassm->pos + 1) & allpassm->mask;
+	return lr_sub(lr_mul(lr_set1(allpassm->decay), z1), lr_mul(w, mfeedback));
 }
 
 //
@@ -593,14 +914,15 @@ static inline float allpassm_step(sf_rv_allpassm_st *allpassm, float v, float mo
 //
 static inline void comb_make(sf_rv_comb_st *comb, int size){
 	comb->pos = 0;
-	comb->size = clampi(size, 1, SF_REVERB_CS);
-	memset(comb->buf, 0, sizeof(float) * comb->size);
+	comb->size = size < 1 ? 1 : size;
+	comb->mask = ring_mask(comb->size);
+	comb->buf = NULL;
 }
 
-static inline float comb_step(sf_rv_comb_st *comb, float v, float feedback){
-	v = comb->buf[comb->pos] * feedback + v;
-	comb->buf[comb->pos] = v;
-	comb->pos = (comb->pos + 1) % comb->size;
+static inline lr_v comb_step(sf_rv_comb_st *comb, lr_v v, lr_v feedback){
+	v = lr_add(lr_mul(lr_load(&comb->buf[(comb->pos - comb->size) & comb->mask]), feedback), v);
+	lr_store(&comb->buf[comb->pos], lr_add(v, lr_set1(SF_DENORMAL_OFFSET)));
+	comb->pos = (comb->pos + 1) & comb->mask;
 	return v;
 }
 
@@ -612,7 +934,51 @@ static inline float comb_step(sf_rv_comb_st *comb, float v, float feedback){
 
 // now that all the components are done (thank god), we can start on the actual reverb effect
 
-void sf_presetreverb(sf_reverb_state_st *rv, int rate, sf_reverb_preset preset){
+// hands out the buffers of the components one after another; when `data` is NULL, it only counts
+// how many floats are needed
+typedef struct {
+	float *data;
+	size_t used;
+} arena_st;
+
+static inline float *arena_take(arena_st *arena, int size){
+	float *buf = arena->data ? &arena->data[arena->used] : NULL;
+	arena->used += size;
+	return buf;
+}
+
+// same as above, for a ring of sf_sample_st
+static inline sf_sample_st *arena_takelr(arena_st *arena, int size){
+	return (sf_sample_st *)arena_take(arena, 2 * size);
+}
+
+static void reverb_layout(sf_reverb_state_st *rv, arena_st *a){
+	rv->earlyref.delayPWL.buf = arena_take(a, rv->earlyref.delayPWL.mask + 4);
+	rv->earlyref.delayPWR.buf = arena_take(a, rv->earlyref.delayPWR.mask + 4);
+	rv->earlyref.delayRL.buf  = arena_take(a, rv->earlyref.delayRL.mask + 1);
+	rv->earlyref.delayLR.buf  = arena_take(a, rv->earlyref.delayLR.mask + 1);
+	rv->noise.buf = arena_take(a, SF_REVERB_NS);
+	for (int i = 0; i < 10; i++)
+		rv->diff[i].buf = arena_takelr(a, rv->diff[i].mask + 1);
+	for (int i = 0; i < 4; i++)
+		rv->cross[i].buf = arena_takelr(a, rv->cross[i].mask + 1);
+	rv->cdelay.buf    = arena_takelr(a, rv->cdelay.mask + 1);
+	rv->dampap1.buf   = arena_takelr(a, rv->dampap1.mask + 1);
+	rv->dampd.buf     = arena_takelr(a, rv->dampd.mask + 1);
+	rv->dampap2.buf   = arena_takelr(a, rv->dampap2.mask + 1);
+	rv->cbassd1.buf   = arena_takelr(a, rv->cbassd1.mask + 1);
+	rv->cbassap1.buf1 = arena_takelr(a, rv->cbassap1.mask1 + 1);
+	rv->cbassap1.buf2 = arena_takelr(a, rv->cbassap1.mask2 + 1);
+	rv->cbassd2.buf   = arena_takelr(a, rv->cbassd2.mask + 1);
+	rv->cbassap2.buf1 = arena_takelr(a, rv->cbassap2.mask1 + 1);
+	rv->cbassap2.buf2 = arena_takelr(a, rv->cbassap2.mask2 + 1);
+	rv->cbassap2.buf3 = arena_takelr(a, rv->cbassap2.mask3 + 1);
+	rv->comb.buf      = arena_takelr(a, rv->comb.mask + 1);
+	rv->lastdelay.buf = arena_takelr(a, rv->lastdelay.mask + 1);
+	rv->inpdelay.buf  = arena_takelr(a, rv->inpdelay.mask + 1);
+}
+
+bool sf_presetreverb(sf_reverb_state_st *rv, int rate, sf_reverb_preset preset){
 	// sorry for the bad formatting, I've tried to cram this in as best as I could
 	struct {
 		int osf; float p1, p2, p3, p4, p5, p6, p7, p8, p9, p10, p11, p12, p13, p14, p15, p16;
@@ -642,9 +1008,9 @@ void sf_presetreverb(sf_reverb_state_st *rv, int rate, sf_reverb_preset preset){
 	};
 
 	#define CASE(prs, i)                                                                        \
-		case prs: sf_advancereverb(rv, rate, ps[i].osf, ps[i].p1, ps[i].p2, ps[i].p3, ps[i].p4, \
-			ps[i].p5, ps[i].p6, ps[i].p7, ps[i].p8, ps[i].p9, ps[i].p10, ps[i].p11, ps[i].p12,  \
-			ps[i].p13, ps[i].p14, ps[i].p15, ps[i].p16); return;
+		case prs: return sf_advancereverb(rv, rate, ps[i].osf, ps[i].p1, ps[i].p2, ps[i].p3,      \
+			ps[i].p4, ps[i].p5, ps[i].p6, ps[i].p7, ps[i].p8, ps[i].p9, ps[i].p10, ps[i].p11,   \
+			ps[i].p12, ps[i].p13, ps[i].p14, ps[i].p15, ps[i].p16);
 	switch (preset){
 		CASE(SF_REVERB_PRESET_DEFAULT    ,  0)
 		CASE(SF_REVERB_PRESET_SMALLHALL1 ,  1)
@@ -667,12 +1033,17 @@ void sf_presetreverb(sf_reverb_state_st *rv, int rate, sf_reverb_preset preset){
 		CASE(SF_REVERB_PRESET_LONGREVERB2, 18)
 	}
 	#undef CASE
+	return false;
 }
 
-void sf_advancereverb(sf_reverb_state_st *rv, int rate,
+bool sf_advancereverb(sf_reverb_state_st *rv, int rate,
 	int oversamplefactor, float ertolate, float erefwet, float dry, float ereffactor,
 	float erefwidth, float width, float wet, float wander, float bassb, float spin, float inputlpf,
 	float basslpf, float damplpf, float outputlpf, float rt60, float delay){
+	rv->data = NULL;
+	rv->bytes = 0;
+	if (rate < 1)
+		return false;
 
 	rv->ertolate = ertolate;
 	rv->erefwet = db2lin(erefwet);
@@ -685,12 +1056,10 @@ void sf_advancereverb(sf_reverb_state_st *rv, int rate,
 
 	earlyref_make(&rv->earlyref, rate, ereffactor, erefwidth);
 
-	oversample_make(&rv->oversampleL, oversamplefactor);
-	rv->oversampleR = rv->oversampleL;
-	int osrate = rate * rv->oversampleL.factor;
+	oversample_make(&rv->oversample, oversamplefactor);
+	int osrate = rate * rv->oversample.factor;
 
-	dccut_make(&rv->dccutL, osrate, 5.0f);
-	rv->dccutR = rv->dccutL;
+	dccut_make(&rv->dccut, osrate, 5.0f);
 
 	noise_make(&rv->noise);
 
@@ -704,37 +1073,32 @@ void sf_advancereverb(sf_reverb_state_st *rv, int rate,
 	int totfactor = osrate / 34125;
 	int msize = nextprime(10 * osrate / 34125);
 	for (int i = 0; i < 10; i++){
-		allpassm_make(&rv->diffL[i], nextprime(diffLc[i] * totfactor), msize, -0.78f, 1);
-		allpassm_make(&rv->diffR[i], nextprime(diffRc[i] * totfactor), msize, -0.78f, 1);
+		allpassm_make(&rv->diff[i], nextprime(diffLc[i] * totfactor),
+			nextprime(diffRc[i] * totfactor), msize, -0.78f, 1);
 	}
 
 	static const int crossLc[4] = { 430, 341, 264, 174 };
 	static const int crossRc[4] = { 447, 324, 247, 191 };
 	for (int i = 0; i < 4; i++){
-		allpass_make(&rv->crossL[i], nextprime(crossLc[i] * totfactor), 0.78f, 1);
-		allpass_make(&rv->crossR[i], nextprime(crossRc[i] * totfactor), 0.78f, 1);
+		allpass_make(&rv->cross[i], nextprime(crossLc[i] * totfactor),
+			nextprime(crossRc[i] * totfactor), 0.78f, 1);
 	}
 
-	iir1_makeLPF(&rv->clpfL, osrate, inputlpf);
-	rv->clpfR = rv->clpfL;
+	iir1lr_makeLPF(&rv->clpf, osrate, inputlpf);
 
-	delay_make(&rv->cdelayL , nextprime(1572 * totfactor));
-	delay_make(&rv->cdelayR , nextprime(  16 * totfactor));
-	delay_make(&rv->dampdL  , nextprime(   2 * totfactor));
-	delay_make(&rv->dampdR  , nextprime(       totfactor));
-	delay_make(&rv->cbassd1L, nextprime(1055 * totfactor));
-	delay_make(&rv->cbassd1R, nextprime(1460 * totfactor));
-	delay_make(&rv->cbassd2L, nextprime( 344 * totfactor));
-	delay_make(&rv->cbassd2R, nextprime( 500 * totfactor));
+	delaylr_make(&rv->cdelay , nextprime(1572 * totfactor), nextprime(  16 * totfactor));
+	delaylr_make(&rv->dampd  , nextprime(   2 * totfactor), nextprime(       totfactor));
+	delaylr_make(&rv->cbassd1, nextprime(1055 * totfactor), nextprime(1460 * totfactor));
+	delaylr_make(&rv->cbassd2, nextprime( 344 * totfactor), nextprime( 500 * totfactor));
 
-	biquad_makeAPF(&rv->bassapL, osrate, 150.0f, 4.0f);
-	rv->bassapR = rv->bassapL;
+	sf_rv_biquad_st mono;
+	biquad_makeAPF(&mono, osrate, 150.0f, 4.0f);
+	biquadlr_make(&rv->bassap, &mono);
 
-	biquad_makeLPF(&rv->basslpL, osrate, basslpf, 2.0f);
-	rv->basslpR = rv->basslpL;
+	biquad_makeLPF(&mono, osrate, basslpf, 2.0f);
+	biquadlr_make(&rv->basslp, &mono);
 
-	iir1_makeLPF(&rv->damplpL, osrate, damplpf);
-	rv->damplpR = rv->damplpL;
+	iir1lr_makeLPF(&rv->damplp, osrate, damplpf);
 
 	float decay0 = powf(10.0f, log10f(0.237f) / rt60);
 	float decay1 = powf(10.0f, log10f(0.938f) / rt60);
@@ -742,27 +1106,21 @@ void sf_advancereverb(sf_reverb_state_st *rv, int rate,
 	float decay3 = powf(10.0f, log10f(0.906f) / rt60);
 	rv->loopdecay = decay0;
 	msize = nextprime(32 * totfactor);
-	allpassm_make(&rv->dampap1L, nextprime(239 * totfactor), msize, 0.375f, decay2);
-	allpassm_make(&rv->dampap1R, nextprime(205 * totfactor), msize, 0.375f, decay2);
-	allpassm_make(&rv->dampap2L, nextprime(392 * totfactor), msize, 0.312f, decay3);
-	allpassm_make(&rv->dampap2R, nextprime(329 * totfactor), msize, 0.312f, decay3);
-
-	allpass2_make(&rv->cbassap1L, nextprime(1944 * totfactor), nextprime(612 * totfactor),
-		0.250f, 0.406f, decay1, decay2);
-	allpass2_make(&rv->cbassap1R, nextprime(2032 * totfactor), nextprime(368 * totfactor),
+	allpassm_make(&rv->dampap1, nextprime(239 * totfactor), nextprime(205 * totfactor), msize,
+		0.375f, decay2);
+	allpassm_make(&rv->dampap2, nextprime(392 * totfactor), nextprime(329 * totfactor), msize,
+		0.312f, decay3);
+
+	allpass2_make(&rv->cbassap1,
+		nextprime(1944 * totfactor), nextprime(2032 * totfactor),
+		nextprime( 612 * totfactor), nextprime( 368 * totfactor),
 		0.250f, 0.406f, decay1, decay2);
 
-	allpass3_make(&rv->cbassap2L,
-		nextprime(1212 * totfactor),
-		nextprime( 121 * totfactor),
-		nextprime( 816 * totfactor),
-		nextprime(1264 * totfactor),
-		0.250f, 0.250f, 0.406f, decay1, decay1, decay2);
-	allpass3_make(&rv->cbassap2R,
-		nextprime(1452 * totfactor),
-		nextprime(   5 * totfactor),
-		nextprime( 688 * totfactor),
-		nextprime(1340 * totfactor),
+	allpass3_make(&rv->cbassap2,
+		nextprime(1212 * totfactor), nextprime(1452 * totfactor),
+		nextprime( 121 * totfactor), nextprime(   5 * totfactor),
+		nextprime( 816 * totfactor), nextprime( 688 * totfactor),
+		nextprime(1264 * totfactor), nextprime(1340 * totfactor),
 		0.250f, 0.250f, 0.406f, decay1, decay1, decay2);
 
 	static const int outco[32] = {
@@ -772,170 +1130,189 @@ void sf_advancereverb(sf_reverb_state_st *rv, int rate,
 	for (int i = 0; i < 32; i++)
 		rv->outco[i] = outco[i] * totfactor;
 
-	comb_make(&rv->combL, nextprime(22 * osrate / 1000));
-	rv->combR = rv->combL;
+	comb_make(&rv->comb, nextprime(22 * osrate / 1000));
 
-	biquad_makeLPF(&rv->lastlpfL, osrate, outputlpf, 1.0f);
-	rv->lastlpfR = rv->lastlpfL;
+	biquad_makeLPF(&mono, osrate, outputlpf, 1.0f);
+	biquadlr_make(&rv->lastlpf, &mono);
 
 	int delaysamp = osrate * delay;
 	if (delaysamp >= 0){
-		delay_make(&rv->inpdelayL, 0);
-		delay_make(&rv->inpdelayR, 0);
-		delay_make(&rv->lastdelayL, delaysamp);
-		delay_make(&rv->lastdelayR, delaysamp);
+		delaylr_make(&rv->inpdelay, 0, 0);
+		delaylr_make(&rv->lastdelay, delaysamp, delaysamp);
 	}
 	else{
-		delay_make(&rv->inpdelayL, -delaysamp);
-		delay_make(&rv->inpdelayR, -delaysamp);
-		delay_make(&rv->lastdelayL, 0);
-		delay_make(&rv->lastdelayR, 0);
+		delaylr_make(&rv->inpdelay, -delaysamp, -delaysamp);
+		delaylr_make(&rv->lastdelay, 0, 0);
+	}
+
+	// every size is known, so allocate the buffers together
+	arena_st arena = { NULL, 0 };
+	reverb_layout(rv, &arena);
+	rv->bytes = sizeof(float) * arena.used;
+	rv->data = sf_malloc(rv->bytes);
+	if (rv->data == NULL){
+		rv->bytes = 0;
+		return false;
 	}
+	memset(rv->data, 0, rv->bytes);
+	arena = (arena_st){ rv->data, 0 };
+	reverb_layout(rv, &arena);
+	return true;
+}
+
+void sf_reverb_free(sf_reverb_state_st *rv){
+	if (rv->data)
+		sf_free(rv->data);
+	rv->data = NULL;
+	rv->bytes = 0;
 }
 
 void sf_reverb_process(sf_reverb_state_st *rv, int size, sf_sample_st *input, sf_sample_st *output){
+	sf_denormal_st dn;
+	sf_denormal_begin(&dn);
 	// extra hardcoded constants
 	const float modnoise1 = 0.09f;
 	const float modnoise2 = 0.06f;
 	const float crossfeed = 0.4f;
 
+	// the tank works on both channels at once (see the stereo components above); where the left
+	// and right chains are fed from opposite channels, lr_swap trades them
+	lr_v ertolate  = lr_set1(rv->ertolate);
+	lr_v erefwet   = lr_set1(rv->erefwet);
+	lr_v dry       = lr_set1(rv->dry);
+	lr_v wet1      = lr_set1(rv->wet1);
+	lr_v wet2      = lr_set1(rv->wet2);
+	lr_v loopdecay = lr_set1(rv->loopdecay);
+	lr_v bassb     = lr_set1(rv->bassb);
+
 	// oversample buffer
-	float osL[SF_REVERB_OF], osR[SF_REVERB_OF];
+	lr_v os[SF_REVERB_OF];
+
+	// early reflections
+	sf_sample_st ers[SF_REVERB_BLOCK];
 
 	for (int i = 0; i < size; i++){
-		// early reflection
-		sf_sample_st er = earlyref_step(&rv->earlyref, input[i]);
-		float erL = er.L * rv->ertolate + input[i].L;
-		float erR = er.R * rv->ertolate + input[i].R;
+		// the early reflections are calculated a block at a time
+		if (i % SF_REVERB_BLOCK == 0){
+			int len = size - i < SF_REVERB_BLOCK ? size - i : SF_REVERB_BLOCK;
+			earlyref_process(&rv->earlyref, len, &input[i], ers);
+		}
+		lr_v er = lr_load(&ers[i % SF_REVERB_BLOCK]);
+		lr_v in = lr_load(&input[i]);
 
 		// oversample the single input into multiple outputs
-		oversample_stepup(&rv->oversampleL, erL, osL);
-		oversample_stepup(&rv->oversampleR, erR, osR);
+		oversample_stepup(&rv->oversample, lr_add(lr_mul(er, ertolate), in), os);
 
 		// for each oversampled sample...
-		for (int i2 = 0; i2 < rv->oversampleL.factor; i2++){
+		for (int i2 = 0; i2 < rv->oversample.factor; i2++){
 			// dc cut
-			float outL = dccut_step(&rv->dccutL, osL[i2]);
-			float outR = dccut_step(&rv->dccutR, osR[i2]);
+			lr_v out = dccut_step(&rv->dccut, os[i2]);
 
 			// noise
 			float mnoise = noise_step(&rv->noise);
 			float lfo = (lfo_step(&rv->lfo1) + modnoise1 * mnoise) * rv->wander;
 			lfo = iir1_step(&rv->lfo1_lpf, lfo);
 			mnoise *= modnoise2;
-
-			// diffusion
-			for (int i = 0, s = -1; i < 10; i++, s = -s){
-				outL = allpassm_step(&rv->diffL[i], outL, lfo * s, mnoise);
-				outR = allpassm_step(&rv->diffR[i], outR, lfo, mnoise * s);
+			lr_v lfopos = lr_set(lfo, -lfo);
+			lr_v lfoneg = lr_set(-lfo, lfo);
+			lr_v mnoisepos = lr_set(mnoise, -mnoise);
+			lr_v mnoiseneg = lr_set(-mnoise, mnoise);
+
+			// diffusion; the sign of the left modulation and the right feedback modulation flips
+			// from one stage to the next
+			for (int i = 0; i < 10; i += 2){
+				out = allpassm_step(&rv->diff[i], out, lfoneg, mnoisepos);
+				out = allpassm_step(&rv->diff[i + 1], out, lr_set1(lfo), lr_set1(mnoise));
 			}
 
 			// cross fade
-			float crossL = outL, crossR = outR;
-			for (int i = 0; i < 4; i++){
-				crossL = allpass_step(&rv->crossL[i], crossL);
-				crossR = allpass_step(&rv->crossR[i], crossR);
-			}
-			outL = iir1_step(&rv->clpfL, outL + crossfeed * crossR);
-			outR = iir1_step(&rv->clpfR, outR + crossfeed * crossL);
+			lr_v cross = out;
+			for (int i = 0; i < 4; i++)
+				cross = allpass_step(&rv->cross[i], cross);
+			out = iir1lr_step(&rv->clpf, lr_add(out, lr_mul(lr_set1(crossfeed), lr_swap(cross))));
 
 			// bass boost
-			crossL = delay_getlast(&rv->cdelayL);
-			crossR = delay_getlast(&rv->cdelayR);
-			outL += rv->loopdecay *
-				(crossR + rv->bassb * biquad_step(&rv->basslpL, biquad_step(&rv->bassapL, crossR)));
-			outR += rv->loopdecay *
-				(crossL + rv->bassb * biquad_step(&rv->basslpR, biquad_step(&rv->bassapR, crossL)));
+			cross = lr_swap(delaylr_getlast(&rv->cdelay));
+			out = lr_add(out, lr_mul(loopdecay, lr_add(cross,
+				lr_mul(bassb, biquadlr_step(&rv->basslp, biquadlr_step(&rv->bassap, cross))))));
 
 			// dampening
-			outL = allpassm_step(&rv->dampap2L,
-				delay_step(&rv->dampdL,
-				allpassm_step(&rv->dampap1L,
-				iir1_step(&rv->damplpL, outL), lfo, mnoise)),
-				-lfo, -mnoise);
-			outR = allpassm_step(&rv->dampap2R,
-				delay_step(&rv->dampdR,
-				allpassm_step(&rv->dampap1R,
-				iir1_step(&rv->damplpR, outR), -lfo, -mnoise)),
-				lfo, mnoise);
+			out = allpassm_step(&rv->dampap2,
+				delaylr_step(&rv->dampd,
+				allpassm_step(&rv->dampap1,
+				iir1lr_step(&rv->damplp, out), lfopos, mnoisepos)),
+				lfoneg, mnoiseneg);
 
 			// update cross fade bass boost delay
-			delay_step(&rv->cdelayL,
-				allpass3_step(&rv->cbassap2L,
-				delay_step(&rv->cbassd2L,
-				allpass2_step(&rv->cbassap1L,
-				delay_step(&rv->cbassd1L, outL))),
-					lfo));
-			delay_step(&rv->cdelayR,
-				allpass3_step(&rv->cbassap2R,
-				delay_step(&rv->cbassd2R,
-				allpass2_step(&rv->cbassap1R,
-				delay_step(&rv->cbassd1R, outR))),
-					-lfo));
-
-			//
-			float D1 =
-				delay_get    (&rv->cbassd1L , rv->outco[ 0]);
-			float D2 =
-				delay_get    (&rv->cbassd2L , rv->outco[ 1]) -
-				delay_get    (&rv->cbassd2R , rv->outco[ 2]) +
-				delay_get    (&rv->cbassd2L , rv->outco[ 3]) -
-				delay_get    (&rv->cdelayR  , rv->outco[ 4]) -
-				delay_get    (&rv->cbassd1R , rv->outco[ 5]) -
-				delay_get    (&rv->cbassd2R , rv->outco[ 6]);
-			float D3 =
-				delay_get    (&rv->cdelayL  , rv->outco[ 7]) +
-				allpass2_get1(&rv->cbassap1L, rv->outco[ 8]) +
-				allpass2_get2(&rv->cbassap1L, rv->outco[ 9]) -
-				allpass2_get2(&rv->cbassap1R, rv->outco[10]) +
-				allpass3_get1(&rv->cbassap2L, rv->outco[11]) +
-				allpass3_get2(&rv->cbassap2L, rv->outco[12]) +
-				allpass3_get3(&rv->cbassap2L, rv->outco[13]) -
-				allpass3_get2(&rv->cbassap2R, rv->outco[14]);
-			float D4 =
-				delay_get    (&rv->cdelayL  , rv->outco[15]);
-
-			float B1 =
-				delay_get    (&rv->cbassd1R , rv->outco[16]);
-			float B2 =
-				delay_get    (&rv->cbassd2R , rv->outco[17]) -
-				delay_get    (&rv->cbassd2L , rv->outco[18]) +
-				delay_get    (&rv->cbassd2R , rv->outco[19]) -
-				delay_get    (&rv->cdelayL  , rv->outco[20]) -
-				delay_get    (&rv->cbassd1L , rv->outco[21]) -
-				delay_get    (&rv->cbassd2L , rv->outco[22]);
-			float B3 =
-				delay_get    (&rv->cdelayR  , rv->outco[23]) +
-				allpass2_get1(&rv->cbassap1R, rv->outco[24]) +
-				allpass2_get2(&rv->cbassap1R, rv->outco[25]) -
-				allpass2_get2(&rv->cbassap1L, rv->outco[26]) +
-				allpass3_get1(&rv->cbassap2R, rv->outco[27]) +
-				allpass3_get2(&rv->cbassap2R, rv->outco[28]) +
-				allpass3_get3(&rv->cbassap2R, rv->outco[29]) -
-				allpass3_get2(&rv->cbassap2L, rv->outco[30]);
-			float B4 =
-				delay_get    (&rv->cdelayR  , rv->outco[31]);
-
-			float D = D1 * 0.469f + D2 * 0.219f + D3 * 0.064f + D4 * 0.045f;
-			float B = B1 * 0.469f + B2 * 0.219f + B3 * 0.064f + B4 * 0.045f;
+			delaylr_step(&rv->cdelay,
+				allpass3_step(&rv->cbassap2,
+				delaylr_step(&rv->cbassd2,
+				allpass2_step(&rv->cbassap1,
+				delaylr_step(&rv->cbassd1, out))),
+					lfopos));
+
+			// the output taps; the left channel (D) and right channel (B) mirror each other, so
+			// each line below reads a tap for both
+			int *oc = rv->outco;
+			lr_v D1 =
+				lr_set(delaylr_getL(&rv->cbassd1, oc[ 0]), delaylr_getR(&rv->cbassd1, oc[16]));
+			lr_v D2 =
+				lr_set(delaylr_getL(&rv->cbassd2, oc[ 1]), delaylr_getR(&rv->cbassd2, oc[17]));
+			D2 = lr_sub(D2,
+				lr_set(delaylr_getR(&rv->cbassd2, oc[ 2]), delaylr_getL(&rv->cbassd2, oc[18])));
+			D2 = lr_add(D2,
+				lr_set(delaylr_getL(&rv->cbassd2, oc[ 3]), delaylr_getR(&rv->cbassd2, oc[19])));
+			D2 = lr_sub(D2,
+				lr_set(delaylr_getR(&rv->cdelay , oc[ 4]), delaylr_getL(&rv->cdelay , oc[20])));
+			D2 = lr_sub(D2,
+				lr_set(delaylr_getR(&rv->cbassd1, oc[ 5]), delaylr_getL(&rv->cbassd1, oc[21])));
+			D2 = lr_sub(D2,
+				lr_set(delaylr_getR(&rv->cbassd2, oc[ 6]), delaylr_getL(&rv->cbassd2, oc[22])));
+			lr_v D3 = lr_set(
+				delaylr_getL(&rv->cdelay, oc[ 7]),
+				delaylr_getR(&rv->cdelay, oc[23]));
+			D3 = lr_add(D3, lr_set(
+				allpass2_get1L(&rv->cbassap1, oc[ 8]),
+				allpass2_get1R(&rv->cbassap1, oc[24])));
+			D3 = lr_add(D3, lr_set(
+				allpass2_get2L(&rv->cbassap1, oc[ 9]),
+				allpass2_get2R(&rv->cbassap1, oc[25])));
+			D3 = lr_sub(D3, lr_set(
+				allpass2_get2R(&rv->cbassap1, oc[10]),
+				allpass2_get2L(&rv->cbassap1, oc[26])));
+			D3 = lr_add(D3, lr_set(
+				allpass3_get1L(&rv->cbassap2, oc[11]),
+				allpass3_get1R(&rv->cbassap2, oc[27])));
+			D3 = lr_add(D3, lr_set(
+				allpass3_get2L(&rv->cbassap2, oc[12]),
+				allpass3_get2R(&rv->cbassap2, oc[28])));
+			D3 = lr_add(D3, lr_set(
+				allpass3_get3L(&rv->cbassap2, oc[13]),
+				allpass3_get3R(&rv->cbassap2, oc[29])));
+			D3 = lr_sub(D3, lr_set(
+				allpass3_get2R(&rv->cbassap2, oc[14]),
+				allpass3_get2L(&rv->cbassap2, oc[30])));
+			lr_v D4 =
+				lr_set(delaylr_getL(&rv->cdelay, oc[15]), delaylr_getR(&rv->cdelay, oc[31]));
+
+			lr_v D = lr_add(lr_add(lr_add(
+				lr_mul(D1, lr_set1(0.469f)),
+				lr_mul(D2, lr_set1(0.219f))),
+				lr_mul(D3, lr_set1(0.064f))),
+				lr_mul(D4, lr_set1(0.045f)));
 
 			lfo = iir1_step(&rv->lfo2_lpf, lfo_step(&rv->lfo2) * rv->wander);
-			outL = comb_step(&rv->combL, D, lfo);
-			outR = comb_step(&rv->combR, B, -lfo);
+			out = comb_step(&rv->comb, D, lr_set(lfo, -lfo));
 
-			outL = delay_step(&rv->lastdelayL, biquad_step(&rv->lastlpfL, outL));
-			outR = delay_step(&rv->lastdelayR, biquad_step(&rv->lastlpfR, outR));
+			out = delaylr_step(&rv->lastdelay, biquadlr_step(&rv->lastlpf, out));
 
-			osL[i2] = outL * rv->wet1 + outR * rv->wet2 +
-				delay_step(&rv->inpdelayL, osL[i2]) * rv->dry;
-			osR[i2] = outR * rv->wet1 + outL * rv->wet2 +
-				delay_step(&rv->inpdelayR, osR[i2]) * rv->dry;
+			os[i2] = lr_add(lr_add(lr_mul(out, wet1), lr_mul(lr_swap(out), wet2)),
+				lr_mul(delaylr_step(&rv->inpdelay, os[i2]), dry));
 		}
 
-		float outL = oversample_stepdown(&rv->oversampleL, osL);
-		float outR = oversample_stepdown(&rv->oversampleR, osR);
-		outL += er.L * rv->erefwet + input[i].L * rv->dry;
-		outR += er.R * rv->erefwet + input[i].R * rv->dry;
-		output[i] = (sf_sample_st){ outL, outR };
+		lr_v out = oversample_stepdown(&rv->oversample, os);
+		out = lr_add(out, lr_add(lr_mul(er, erefwet), lr_mul(in, dry)));
+		lr_store(&output[i], out);
 	}
+	sf_denormal_end(&dn);
 }
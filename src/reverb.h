@@ -12,6 +12,7 @@
 #define SNDFILTER_REVERB__H
 
 #include "snd.h"
+#include <stddef.h>
 
 // this API works by first initializing an sf_reverb_state_st structure, then using it to process a
 // sample in chunks
@@ -24,6 +25,12 @@
 //   for each 128 length sample:
 //     sf_reverb_process(&rv, 128, input, output);
 //
+//   sf_reverb_free(&rv);
+//
+// the delay lines are sized for the rate and parameters, and allocated together when the state is
+// initialized, so the state must be freed with sf_reverb_free when it's no longer needed (including
+// before initializing it again)
+//
 // notice that sf_reverb_process will change a lot of the member variables inside of the state
 // structure, since these values must be carried over across chunk boundaries
 //
@@ -59,12 +66,14 @@
 // in one pass
 
 // delay
-// delay buffer size; maximum size allowed for a delay
-#define SF_REVERB_DS        9814
+// the buffers of the delays and all-pass filters below are rings with a power of 2 capacity (mask
+// + 1) that's at least as long as the line, so the positions can wrap with a mask instead of a
+// division
 typedef struct {
-	int pos;                 // current write position
-	int size;                // delay size
-	float buf[SF_REVERB_DS]; // delay buffer
+	int pos;    // current write position
+	int size;   // delay size
+	int mask;   // ring capacity - 1
+	float *buf; // delay buffer
 } sf_rv_delay_st;
 
 // 1st order IIR filter
@@ -91,6 +100,9 @@ typedef struct {
 } sf_rv_biquad_st;
 
 // early reflection
+// the taps are summed for a block of SF_REVERB_BLOCK samples at a time, so the two tap lines have
+// room for a block past their size, plus 3 values repeated after the end of the ring
+#define SF_REVERB_BLOCK     256
 typedef struct {
 	int             delaytblL[18], delaytblR[18];
 	sf_rv_delay_st  delayPWL     , delayPWR     ;
@@ -102,28 +114,65 @@ typedef struct {
 	float wet1, wet2;
 } sf_rv_earlyref_st;
 
+//
+// everything after the early reflections (the oversampled "tank") runs the left and right channels
+// through mirror image chains, so the components below are stereo: the state of both channels is
+// interleaved in sf_sample_st values, and each ring holds an sf_sample_st per position, so one SIMD
+// instruction can advance both channels; the two channels of a line can still have different
+// lengths
+//
+
+// stereo delay
+typedef struct {
+	int pos;
+	int sizeL, sizeR;
+	int mask;
+	sf_sample_st *buf;
+} sf_rv_delaylr_st;
+
+// stereo 1st order IIR filter
+typedef struct {
+	float a2; // coefficients
+	float b1;
+	float b2;
+	sf_sample_st y1; // state
+} sf_rv_iir1lr_st;
+
+// stereo biquad
+typedef struct {
+	float b0; // biquad coefficients
+	float b1;
+	float b2;
+	float a1;
+	float a2;
+	sf_sample_st xn1; // input[n - 1]
+	sf_sample_st xn2; // input[n - 2]
+	sf_sample_st yn1; // output[n - 1]
+	sf_sample_st yn2; // output[n - 2]
+} sf_rv_biquadlr_st;
+
 // oversampling
 // maximum oversampling factor
 #define SF_REVERB_OF        4
 typedef struct {
-	int factor;           // oversampling factor [1 to SF_REVERB_OF]
-	sf_rv_biquad_st lpfU; // lowpass filter used for upsampling
-	sf_rv_biquad_st lpfD; // lowpass filter used for downsampling
+	int factor;             // oversampling factor [1 to SF_REVERB_OF]
+	sf_rv_biquadlr_st lpfU; // lowpass filter used for upsampling
+	sf_rv_biquadlr_st lpfD; // lowpass filter used for downsampling
 } sf_rv_oversample_st;
 
 // dc cut
 typedef struct {
 	float gain;
-	float y1;
-	float y2;
+	sf_sample_st y1;
+	sf_sample_st y2;
 } sf_rv_dccut_st;
 
 // fractal noise cache
 // noise buffer size; must be a power of 2 because it's generated via fractal generator
 #define SF_REVERB_NS        (1<<15)
 typedef struct {
-	int pos;                 // current read position in the buffer
-	float buf[SF_REVERB_NS]; // buffer filled with noise
+	int pos;    // current read position in the buffer
+	float *buf; // buffer filled with noise (SF_REVERB_NS values)
 } sf_rv_noise_st;
 
 // low-frequency oscilator (LFO)
@@ -136,97 +185,89 @@ typedef struct {
 } sf_rv_lfo_st;
 
 // all-pass filter
-// maximum size
-#define SF_REVERB_APS       6299
 typedef struct {
 	int pos;
-	int size;
+	int sizeL, sizeR;
+	int mask;
 	float feedback;
 	float decay;
-	float buf[SF_REVERB_APS];
+	sf_sample_st *buf;
 } sf_rv_allpass_st;
 
 // 2nd order all-pass filter
-// maximum sizes of the two buffers
-#define SF_REVERB_AP2S1     11437
-#define SF_REVERB_AP2S2     3449
 typedef struct {
-	//    line 1                 line 2
-	int   pos1                 , pos2                 ;
-	int   size1                , size2                ;
-	float feedback1            , feedback2            ;
-	float decay1               , decay2               ;
-	float buf1[SF_REVERB_AP2S1], buf2[SF_REVERB_AP2S2];
+	//           line 1            line 2
+	int          pos1            , pos2            ;
+	int          size1L, size1R  , size2L, size2R  ;
+	int          mask1           , mask2           ;
+	float        feedback1       , feedback2       ;
+	float        decay1          , decay2          ;
+	sf_sample_st *buf1           , *buf2           ;
 } sf_rv_allpass2_st;
 
 // 3rd order all-pass filter with modulation
-// maximum sizes of the three buffers and maximum mod size of the first line
-#define SF_REVERB_AP3S1     8171
-#define SF_REVERB_AP3M1     683
-#define SF_REVERB_AP3S2     4597
-#define SF_REVERB_AP3S3     7541
 typedef struct {
-	//    line 1 (with modulation)                 line 2                 line 3
-	int   rpos1, wpos1                           , pos2                 , pos3                 ;
-	int   size1, msize1                          , size2                , size3                ;
-	float feedback1                              , feedback2            , feedback3            ;
-	float decay1                                 , decay2               , decay3               ;
-	float buf1[SF_REVERB_AP3S1 + SF_REVERB_AP3M1], buf2[SF_REVERB_AP3S2], buf3[SF_REVERB_AP3S3];
+	//           line 1 (with modulation)   line 2            line 3
+	int          pos1                     , pos2            , pos3            ;
+	int          size1L, size1R           , size2L, size2R  , size3L, size3R  ;
+	int          msize1L, msize1R         ;
+	int          mask1                    , mask2           , mask3           ;
+	float        feedback1                , feedback2       , feedback3       ;
+	float        decay1                   , decay2          , decay3          ;
+	sf_sample_st *buf1                    , *buf2           , *buf3           ;
 } sf_rv_allpass3_st;
 
 // modulated all-pass filter
-// maximum size and maximum mod size
-#define SF_REVERB_APMS      8681
-#define SF_REVERB_APMM      137
 typedef struct {
-	int rpos, wpos;
-	int size, msize;
+	int pos;
+	int sizeL, sizeR;
+	int msize;
+	int mask;
 	float feedback;
 	float decay;
-	float z1;
-	float buf[SF_REVERB_APMS + SF_REVERB_APMM];
+	sf_sample_st z1;
+	sf_sample_st *buf;
 } sf_rv_allpassm_st;
 
-// comb filter
-// maximum size of the buffer
-#define SF_REVERB_CS        4229
+// comb filter (both channels have the same length)
 typedef struct {
 	int pos;
 	int size;
-	float buf[SF_REVERB_CS];
+	int mask;
+	sf_sample_st *buf;
 } sf_rv_comb_st;
 
 //
 // the final reverb state structure
 //
-// note: this is about 2megs, so you might not want to throw these around willy-nilly
+// note: every buffer above points into `data`, so a state can't be copied, only re-initialized
 typedef struct {
 	sf_rv_earlyref_st   earlyref;
-	sf_rv_oversample_st oversampleL, oversampleR;
-	sf_rv_dccut_st      dccutL     , dccutR     ;
+	sf_rv_oversample_st oversample;
+	sf_rv_dccut_st      dccut;
 	sf_rv_noise_st      noise;
 	sf_rv_lfo_st        lfo1;
 	sf_rv_iir1_st       lfo1_lpf;
-	sf_rv_allpassm_st   diffL[10]  , diffR[10]  ;
-	sf_rv_allpass_st    crossL[4]  , crossR[4]  ;
-	sf_rv_iir1_st       clpfL      , clpfR      ; // cross LPF
-	sf_rv_delay_st      cdelayL    , cdelayR    ; // cross delay
-	sf_rv_biquad_st     bassapL    , bassapR    ; // bass all-pass
-	sf_rv_biquad_st     basslpL    , basslpR    ; // bass lowpass
-	sf_rv_iir1_st       damplpL    , damplpR    ; // dampening lowpass
-	sf_rv_allpassm_st   dampap1L   , dampap1R   ; // dampening all-pass (1)
-	sf_rv_delay_st      dampdL     , dampdR     ; // dampening delay
-	sf_rv_allpassm_st   dampap2L   , dampap2R   ; // dampening all-pass (2)
-	sf_rv_delay_st      cbassd1L   , cbassd1R   ; // cross-fade bass delay (1)
-	sf_rv_allpass2_st   cbassap1L  , cbassap1R  ; // cross-fade bass allpass (1)
-	sf_rv_delay_st      cbassd2L   , cbassd2R   ; // cross-fade bass delay (2)
-	sf_rv_allpass3_st   cbassap2L  , cbassap2R  ; // cross-fade bass allpass (2)
+	sf_rv_allpassm_st   diff[10];
+	sf_rv_allpass_st    cross[4];
+	sf_rv_iir1lr_st     clpf;      // cross LPF
+	sf_rv_delaylr_st    cdelay;    // cross delay
+	sf_rv_biquadlr_st   bassap;    // bass all-pass
+	sf_rv_biquadlr_st   basslp;    // bass lowpass
+	sf_rv_iir1lr_st     damplp;    // dampening lowpass
+	sf_rv_allpassm_st   dampap1;   // dampening all-pass (1)
+	sf_rv_delaylr_st    dampd;     // dampening delay
+	sf_rv_allpassm_st   dampap2;   // dampening all-pass (2)
+	sf_rv_delaylr_st    cbassd1;   // cross-fade bass delay (1)
+	sf_rv_allpass2_st   cbassap1;  // cross-fade bass allpass (1)
+	sf_rv_delaylr_st    cbassd2;   // cross-fade bass delay (2)
+	sf_rv_allpass3_st   cbassap2;  // cross-fade bass allpass (2)
 	sf_rv_lfo_st        lfo2;
 	sf_rv_iir1_st       lfo2_lpf;
-	sf_rv_comb_st       combL      , combR      ;
-	sf_rv_biquad_st     lastlpfL   , lastlpfR   ;
-	sf_rv_delay_st      lastdelayL , lastdelayR ;
-	sf_rv_delay_st      inpdelayL  , inpdelayR  ;
+	sf_rv_comb_st       comb;
+	sf_rv_biquadlr_st   lastlpf;
+	sf_rv_delaylr_st    lastdelay;
+	sf_rv_delaylr_st    inpdelay;
 	int outco[32];
 	float loopdecay;
 	float wet1, wet2;
@@ -235,6 +276,8 @@ typedef struct {
 	float ertolate; // early reflection mix parameters
 	float erefwet;
 	float dry;
+	float *data;  // storage for every buffer above
+	size_t bytes; // size of data
 } sf_reverb_state_st;
 
 typedef enum {
@@ -260,10 +303,11 @@ typedef enum {
 } sf_reverb_preset;
 
 // populate a reverb state with a preset
-void sf_presetreverb(sf_reverb_state_st *state, int rate, sf_reverb_preset preset);
+// (the init functions return false for error)
+bool sf_presetreverb(sf_reverb_state_st *state, int rate, sf_reverb_preset preset);
 
 // populate a reverb state with advanced parameters
-void sf_advancereverb(sf_reverb_state_st *rv,
+bool sf_advancereverb(sf_reverb_state_st *rv,
 	int rate,             // input sample rate (samples per second)
 	int oversamplefactor, // how much to oversample [1 to 4]
 	float ertolate,       // early reflection amount [0 to 1]
@@ -284,6 +328,9 @@ void sf_advancereverb(sf_reverb_state_st *rv,
 	float delay           // seconds, amount of delay [-0.5 to 0.5]
 );
 
+// free the delay lines of an initialized state
+void sf_reverb_free(sf_reverb_state_st *state);
+
 // this function will process the input sound based on the state passed
 // the input and output buffers should be the same size
 void sf_reverb_process(sf_reverb_state_st *state, int size, sf_sample_st *input,
@@ -29,3 +29,48 @@ void sf_snd_free(sf_snd snd){
 	sf_free(snd->samples);
 	sf_free(snd);
 }
+
+sf_snd16 sf_snd16_new(int size, int rate, bool clear){
+	sf_snd16 snd = sf_malloc(sizeof(sf_snd16_st));
+	if (snd == NULL)
+		return NULL;
+	snd->size = size;
+	snd->rate = rate;
+	snd->samples = sf_malloc(sizeof(sf_sample16_st) * size);
+	if (snd->samples == NULL){
+		sf_free(snd);
+		return NULL;
+	}
+	if (clear && size > 0)
+		memset(snd->samples, 0, sizeof(sf_sample16_st) * size);
+	return snd;
+}
+
+void sf_snd16_free(sf_snd16 snd){
+	sf_free(snd->samples);
+	sf_free(snd);
+}
+
+sf_sndn sf_sndn_new(int channels, int size, int rate, bool clear){
+	if (channels < 1 || channels > SF_SND_MAXCHANNELS)
+		return NULL;
+	sf_sndn snd = sf_malloc(sizeof(sf_sndn_st));
+	if (snd == NULL)
+		return NULL;
+	snd->channels = channels;
+	snd->size = size;
+	snd->rate = rate;
+	snd->samples = sf_malloc(sizeof(float) * channels * size);
+	if (snd->samples == NULL){
+		sf_free(snd);
+		return NULL;
+	}
+	if (clear && size > 0)
+		memset(snd->samples, 0, sizeof(float) * channels * size);
+	return snd;
+}
+
+void sf_sndn_free(sf_sndn snd){
+	sf_free(snd->samples);
+	sf_free(snd);
+}
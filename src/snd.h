@@ -5,12 +5,14 @@
 // SPDX-License-Identifier: 0BSD
 //
 
-// data structure for a 2-channel 32-bit floating point sound in memory
+// data structures for a 2-channel 32-bit floating point sound in memory, a 2-channel 16-bit integer
+// sound for the fixed-point filters, and an N-channel 32-bit floating point sound
 
 #ifndef SNDFILTER_SND__H
 #define SNDFILTER_SND__H
 
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef struct {
 	float L; // left channel sample
@@ -26,4 +28,34 @@ typedef struct {
 sf_snd sf_snd_new(int size, int rate, bool clear);
 void   sf_snd_free(sf_snd snd);
 
+// 16-bit samples range from -32768 to 32767
+typedef struct {
+	int16_t L; // left channel sample
+	int16_t R; // right channel sample
+} sf_sample16_st;
+
+typedef struct {
+	sf_sample16_st *samples;
+	int size; // number of samples
+	int rate; // samples per second
+} sf_snd16_st, *sf_snd16;
+
+sf_snd16 sf_snd16_new(int size, int rate, bool clear);
+void     sf_snd16_free(sf_snd16 snd);
+
+// maximum number of channels in an N-channel sound (enough for 7.1)
+#define SF_SND_MAXCHANNELS 8
+
+// the samples are interleaved, so sample i of channel c is samples[i * channels + c]; a stereo
+// sound has the same layout as sf_snd_st
+typedef struct {
+	float *samples;
+	int channels; // number of channels [1 to SF_SND_MAXCHANNELS]
+	int size;     // number of samples per channel
+	int rate;     // samples per second
+} sf_sndn_st, *sf_sndn;
+
+sf_sndn sf_sndn_new(int channels, int size, int rate, bool clear);
+void    sf_sndn_free(sf_sndn snd);
+
 #endif // SNDFILTER_SND__H
@@ -39,25 +39,18 @@ static inline void write_u16le(FILE *fp, uint16_t v){
 	fputc((v >> 8) & 0xFF, fp);
 }
 
-// load a WAV file (returns NULL for error)
-sf_snd sf_wavload(const char *file){
-	FILE *fp = fopen(file, "rb");
-	if (fp == NULL)
-		return NULL;
-
+// read the chunks of a WAV file up to the start of the sample data, leaving the file positioned at
+// the first sample (returns false for error, or if the file has more than maxchannels channels)
+static bool read_header(FILE *fp, int maxchannels, int *channels, int *rate, int *count){
 	uint32_t riff = read_u32le(fp);
-	if (riff != 0x46464952){ // 'RIFF'
-		fclose(fp);
-		return NULL;
-	}
+	if (riff != 0x46464952) // 'RIFF'
+		return false;
 
 	read_u32le(fp); // filesize; don't really care about this
 
 	uint32_t wave = read_u32le(fp);
-	if (wave != 0x45564157){ // 'WAVE'
-		fclose(fp);
-		return NULL;
-	}
+	if (wave != 0x45564157) // 'WAVE'
+		return false;
 
 	// start reading chunks
 	bool found_fmt = false;
@@ -71,10 +64,8 @@ sf_snd sf_wavload(const char *file){
 		if (chunkid == 0x20746D66){ // 'fmt '
 
 			// confirm we haven't already processed the fmt chunk, and that it's a good size
-			if (found_fmt || chunksize < 16){
-				fclose(fp);
-				return NULL;
-			}
+			if (found_fmt || chunksize < 16)
+				return false;
 
 			found_fmt = true;
 
@@ -85,60 +76,38 @@ sf_snd sf_wavload(const char *file){
 			read_u32le(fp); // byte rate, ignored
 			read_u16le(fp); // block align, ignored
 			bps         = read_u16le(fp);
+			uint32_t fmtsize = 16;
 
-			// only support 1/2-channel 16-bit samples
-			if (audioformat != 1 || bps != 16 || (numchannels != 1 && numchannels != 2)){
-				fclose(fp);
-				return NULL;
+			// files with more than 2 channels usually use the extensible format, which stores the
+			// real format in the first two bytes of the sub-format GUID
+			if (audioformat == 0xFFFE && chunksize >= 40){
+				read_u16le(fp); // extension size, ignored
+				read_u16le(fp); // valid bits per sample, ignored
+				read_u32le(fp); // channel mask, ignored
+				audioformat = read_u16le(fp);
+				fmtsize = 26;
 			}
 
+			// only support 16-bit samples
+			if (audioformat != 1 || bps != 16 || numchannels < 1 || numchannels > maxchannels)
+				return false;
+
 			// skip ahead of the rest of the fmt chunk
-			if (chunksize > 16)
-				fseek(fp, chunksize - 16, SEEK_CUR);
+			if (chunksize > fmtsize)
+				fseek(fp, chunksize - fmtsize, SEEK_CUR);
 		}
 		else if (chunkid == 0x61746164){ // 'data'
 
 			// confirm we've already processed the fmt chunk
 			// confirm chunk size is evenly divisible by bytes per sample
-			if (!found_fmt || (chunksize % (numchannels * bps / 8)) != 0){
-				fclose(fp);
-				return NULL;
-			}
-
-			// calculate the number of samples based on the chunk size and allocate the space
-			int scount = chunksize / (numchannels * bps / 8);
-			sf_snd snd = sf_snd_new(scount, samplerate, false);
-			if (snd == NULL){
-				fclose(fp);
-				return NULL;
-			}
-
-			// read the data and convert to stereo floating point
-			int16_t L, R;
-			for (int i = 0; i < scount; i++){
-				// read the sample
-				L = (int16_t)read_u16le(fp);
-				if (numchannels == 1)
-					R = L; // expand to stereo
-				else
-					R = (int16_t)read_u16le(fp);
-
-				// convert the sample to floating point
-				// notice that int16 samples range from -32768 to 32767, therefore we have a
-				// different divisor depending on whether the value is negative or not
-				if (L < 0)
-					snd->samples[i].L = (float)L / 32768.0f;
-				else
-					snd->samples[i].L = (float)L / 32767.0f;
-				if (R < 0)
-					snd->samples[i].R = (float)R / 32768.0f;
-				else
-					snd->samples[i].R = (float)R / 32767.0f;
-			}
+			if (!found_fmt || (chunksize % (numchannels * bps / 8)) != 0)
+				return false;
 
-			// we've loaded the wav data, so just return now
-			fclose(fp);
-			return snd;
+			// calculate the number of samples based on the chunk size
+			*channels = numchannels;
+			*rate = samplerate;
+			*count = chunksize / (numchannels * bps / 8);
+			return true;
 		}
 		else{ // skip an unknown chunk
 			if (chunksize > 0)
@@ -147,39 +116,137 @@ sf_snd sf_wavload(const char *file){
 	}
 
 	// didn't find data chunk, so fail
+	return false;
+}
+
+// load a WAV file (returns NULL for error)
+sf_snd sf_wavload(const char *file){
+	FILE *fp = fopen(file, "rb");
+	if (fp == NULL)
+		return NULL;
+
+	int numchannels, samplerate, scount;
+	if (!read_header(fp, 2, &numchannels, &samplerate, &scount)){
+		fclose(fp);
+		return NULL;
+	}
+
+	sf_snd snd = sf_snd_new(scount, samplerate, false);
+	if (snd == NULL){
+		fclose(fp);
+		return NULL;
+	}
+
+	// read the data and convert to stereo floating point
+	int16_t L, R;
+	for (int i = 0; i < scount; i++){
+		// read the sample
+		L = (int16_t)read_u16le(fp);
+		if (numchannels == 1)
+			R = L; // expand to stereo
+		else
+			R = (int16_t)read_u16le(fp);
+
+		// convert the sample to floating point
+		// notice that int16 samples range from -32768 to 32767, therefore we have a
+		// different divisor depending on whether the value is negative or not
+		if (L < 0)
+			snd->samples[i].L = (float)L / 32768.0f;
+		else
+			snd->samples[i].L = (float)L / 32767.0f;
+		if (R < 0)
+			snd->samples[i].R = (float)R / 32768.0f;
+		else
+			snd->samples[i].R = (float)R / 32767.0f;
+	}
+
+	// we've loaded the wav data, so just return now
+	fclose(fp);
+	return snd;
+}
+
+// load a WAV file without converting the samples (returns NULL for error)
+sf_snd16 sf_wavload16(const char *file){
+	FILE *fp = fopen(file, "rb");
+	if (fp == NULL)
+		return NULL;
+
+	int numchannels, samplerate, scount;
+	if (!read_header(fp, 2, &numchannels, &samplerate, &scount)){
+		fclose(fp);
+		return NULL;
+	}
+
+	sf_snd16 snd = sf_snd16_new(scount, samplerate, false);
+	if (snd == NULL){
+		fclose(fp);
+		return NULL;
+	}
+
+	for (int i = 0; i < scount; i++){
+		int16_t L = (int16_t)read_u16le(fp);
+		snd->samples[i].L = L;
+		snd->samples[i].R = numchannels == 1 ? L : (int16_t)read_u16le(fp);
+	}
+
 	fclose(fp);
-	return NULL;
+	return snd;
 }
 
 static float clampf(float v, float min, float max){
 	return v < min ? min : (v > max ? max : v);
 }
 
+// default speaker positions for each channel count, used by the extensible format
+static const uint32_t channelmasks[SF_SND_MAXCHANNELS + 1] = {
+	0, 0x4, 0x3, 0x7, 0x33, 0x37, 0x3F, 0x13F, 0x63F
+};
+
+// write the header for a 16-bit WAV file with `size` samples (returns false for error)
+static bool write_header(FILE *fp, int channels, int size, int rate){
+	// calculate the different file sizes based on sample size
+	bool extensible = channels > 2;
+	uint32_t fmtsize = extensible ? 40 : 16;
+	uint64_t size2 = (uint64_t)size * channels * 2; // total bytes of data
+	uint64_t sizeall = size2 + fmtsize + 20; // total file size minus 8
+	if (size < 0 || sizeall > 0xFFFFFFFF)
+		return false; // sample too large
+
+	write_u32le(fp, 0x46464952);              // 'RIFF'
+	write_u32le(fp, sizeall);                 // rest of file size
+	write_u32le(fp, 0x45564157);              // 'WAVE'
+	write_u32le(fp, 0x20746D66);              // 'fmt '
+	write_u32le(fp, fmtsize);                 // size of fmt chunk
+	write_u16le(fp, extensible ? 0xFFFE : 1); // audio format
+	write_u16le(fp, channels);                // number of channels
+	write_u32le(fp, rate);                    // sample rate
+	write_u32le(fp, rate * channels * 2);     // bytes per second
+	write_u16le(fp, channels * 2);            // block align
+	write_u16le(fp, 16);                      // bits per sample
+	if (extensible){
+		write_u16le(fp, 22);                      // size of the extension
+		write_u16le(fp, 16);                      // valid bits per sample
+		write_u32le(fp, channelmasks[channels]);  // speaker positions
+		write_u32le(fp, 0x00000001);              // sub-format GUID for PCM
+		write_u32le(fp, 0x00100000);
+		write_u32le(fp, 0xAA000080);
+		write_u32le(fp, 0x719B3800);
+	}
+	write_u32le(fp, 0x61746164);              // 'data'
+	write_u32le(fp, size2);                   // size of data chunk
+	return true;
+}
+
 // save a WAV file (returns false for error)
 bool sf_wavsave(sf_snd snd, const char *file){
 	FILE *fp = fopen(file, "wb");
 	if (fp == NULL)
 		return false;
 
-	// calculate the different file sizes based on sample size
-	uint32_t size2 = snd->size * 4; // total bytes of data
-	uint32_t sizeall = size2 + 36; // total file size minus 8
-	if (snd->size > size2 || snd->size > sizeall || size2 > sizeall)
-		return false; // sample too large
-
-	write_u32le(fp, 0x46464952);    // 'RIFF'
-	write_u32le(fp, sizeall);       // rest of file size
-	write_u32le(fp, 0x45564157);    // 'WAVE'
-	write_u32le(fp, 0x20746D66);    // 'fmt '
-	write_u32le(fp, 16);            // size of fmt chunk
-	write_u16le(fp, 1);             // audio format
-	write_u16le(fp, 2);             // stereo
-	write_u32le(fp, snd->rate);     // sample rate
-	write_u32le(fp, snd->rate * 4); // bytes per second
-	write_u16le(fp, 4);             // block align
-	write_u16le(fp, 16);            // bits per sample
-	write_u32le(fp, 0x61746164);    // 'data'
-	write_u32le(fp, size2);         // size of data chunk
+	if (!write_header(fp, 2, snd->size, snd->rate)){
+		fclose(fp);
+		return false;
+	}
 
 	// convert the sample to stereo 16-bit, and write to file
 	for (int i = 0; i < snd->size; i++){
@@ -203,3 +270,78 @@ bool sf_wavsave(sf_snd snd, const char *file){
 	fclose(fp);
 	return true;
 }
+
+// save a WAV file without converting the samples (returns false for error)
+bool sf_wavsave16(sf_snd16 snd, const char *file){
+	FILE *fp = fopen(file, "wb");
+	if (fp == NULL)
+		return false;
+
+	if (!write_header(fp, 2, snd->size, snd->rate)){
+		fclose(fp);
+		return false;
+	}
+
+	for (int i = 0; i < snd->size; i++){
+		write_u16le(fp, (uint16_t)snd->samples[i].L);
+		write_u16le(fp, (uint16_t)snd->samples[i].R);
+	}
+
+	fclose(fp);
+	return true;
+}
+
+// convert between floating point and int16 samples, the same way as sf_wavload and sf_wavsave
+static inline float sample_float(int16_t v){
+	return v < 0 ? (float)v / 32768.0f : (float)v / 32767.0f;
+}
+
+static inline int16_t sample_int16(float v){
+	v = clampf(v, -1, 1);
+	return v < 0 ? (int16_t)(v * 32768.0f) : (int16_t)(v * 32767.0f);
+}
+
+// load a WAV file with any number of channels (returns NULL for error)
+sf_sndn sf_wavloadn(const char *file){
+	FILE *fp = fopen(file, "rb");
+	if (fp == NULL)
+		return NULL;
+
+	int numchannels, samplerate, scount;
+	if (!read_header(fp, SF_SND_MAXCHANNELS, &numchannels, &samplerate, &scount)){
+		fclose(fp);
+		return NULL;
+	}
+
+	sf_sndn snd = sf_sndn_new(numchannels, scount, samplerate, false);
+	if (snd == NULL){
+		fclose(fp);
+		return NULL;
+	}
+
+	int total = scount * numchannels;
+	for (int i = 0; i < total; i++)
+		snd->samples[i] = sample_float((int16_t)read_u16le(fp));
+
+	fclose(fp);
+	return snd;
+}
+
+// save a WAV file with the same number of channels as the sound (returns false for error)
+bool sf_wavsaven(sf_sndn snd, const char *file){
+	FILE *fp = fopen(file, "wb");
+	if (fp == NULL)
+		return false;
+
+	if (!write_header(fp, snd->channels, snd->size, snd->rate)){
+		fclose(fp);
+		return false;
+	}
+
+	int total = snd->size * snd->channels;
+	for (int i = 0; i < total; i++)
+		write_u16le(fp, (uint16_t)sample_int16(snd->samples[i]));
+
+	fclose(fp);
+	return true;
+}
@@ -8,6 +8,7 @@
 // simple .wav file loading and saving
 // only handles loading 1 or 2 channel WAVs with 16-bit samples
 // only saves 2 channel WAVs with 16-bit samples
+// except for the N-channel versions, which keep the channels of the file (up to SF_SND_MAXCHANNELS)
 
 #ifndef SNDFILTER_WAV__H
 #define SNDFILTER_WAV__H
@@ -17,4 +18,14 @@
 sf_snd sf_wavload(const char *file);
 bool   sf_wavsave(sf_snd snd, const char *file);
 
+// same as above, except the samples are kept as 16-bit integers instead of being converted to and
+// from floating point
+sf_snd16 sf_wavload16(const char *file);
+bool     sf_wavsave16(sf_snd16 snd, const char *file);
+
+// same as sf_wavload/sf_wavsave, except the channels aren't forced to stereo, so a mono file stays
+// mono (and takes half the memory)
+sf_sndn sf_wavloadn(const char *file);
+bool    sf_wavsaven(sf_sndn snd, const char *file);
+
 #endif // SNDFILTER_WAV__H